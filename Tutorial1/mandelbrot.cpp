@@ -54,6 +54,15 @@ void Mandelbrot::draw()
 	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
 }
 
+void Mandelbrot::setView(real_t x, real_t y, real_t scale, uint32_t iter)
+{
+	pos_x       = x;
+	pos_y       = y;
+	this->scale = scale;
+	this->iter  = iter;
+	updated     = false;
+}
+
 void Mandelbrot::drawSurface()
 {
 	real_t min_x = pos_x - 2. * scale * aspect;
@@ -12,7 +12,8 @@ public:
 
 	void draw();
 
-private:
+	// for the ladder in Tutorial7, which times drawSurface() over the same views in every tutorial
+	void setView(real_t x, real_t y, real_t scale, uint32_t iter);
 	void drawSurface();
 
 private:
@@ -28,7 +28,7 @@ public:
 
 	std::complex<real_t> pixelToComplex(real_t px, real_t py) const;
 
-private:
+	// for the ladder in Tutorial7, which times it without the texture upload of draw()
 	void drawSurface();
 
 private:
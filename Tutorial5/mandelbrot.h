@@ -76,7 +76,7 @@ public:
 			return *(pixels + py * width + px);
 		};
 
-		PixelInfo* pixels;
+		PixelInfo* pixels = nullptr;
 		uint32_t   width;
 		uint32_t   height;
 	};
@@ -84,7 +84,7 @@ public:
 			return *(pixels + py * width + px);
 		};
 
-		PixelInfo* pixels;
+		PixelInfo* pixels = nullptr;
 		uint32_t   width;
 		uint32_t   height;
 	};
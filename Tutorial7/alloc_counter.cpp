@@ -0,0 +1,65 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+using namespace std;
+
+static atomic<uint64_t> alloc_count = 0;
+static atomic<uint64_t> alloc_bytes = 0;
+
+uint64_t AllocCounter::getCount() { return alloc_count.load(memory_order_relaxed); }
+uint64_t AllocCounter::getBytes() { return alloc_bytes.load(memory_order_relaxed); }
+
+static inline void count(size_t size)
+{
+	alloc_count.fetch_add(1, memory_order_relaxed);
+	alloc_bytes.fetch_add(size, memory_order_relaxed);
+}
+
+// the array and nothrow forms of the standard library forward to these
+
+void* operator new(size_t size)
+{
+	count(size);
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void* operator new(size_t size, align_val_t align)
+{
+	count(size);
+	auto alignment = (size_t)align;
+	size = (size + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+	if (void* p = _aligned_malloc(size ? size : alignment, alignment)) return p;
+#else
+	if (void* p = aligned_alloc(alignment, size ? size : alignment)) return p;
+#endif
+	throw bad_alloc();
+}
+
+void operator delete(void* p, align_val_t) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void operator delete(void* p, size_t, align_val_t align) noexcept
+{
+	operator delete(p, align);
+}
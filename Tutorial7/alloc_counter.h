@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// counts the heap allocations of the whole program: alloc_counter.cpp replaces the global
+// operator new of every program that links it. SDL, ImGui and TBB allocate through malloc or
+// their own allocators and are not seen.
+class AllocCounter
+{
+	AllocCounter() = delete;
+
+public:
+	static uint64_t getCount();
+	static uint64_t getBytes();
+};
@@ -0,0 +1,527 @@
+#define SDL_MAIN_HANDLED
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cfloat>
+#include <map>
+#include <thread>
+#include <random>
+
+#define TIME_IMPL
+#include "view_spec.h"
+#include "bench_views.h"
+#include "alloc_counter.h"
+#include "reproject.h"
+#include "gui.h"
+#include "time.h"
+
+// renders a fixed catalogue of views on every CPU backend and reports throughput:
+//   Tutorial7Bench --json before.json
+// every case is checked against a plain double loop that shares nothing with the backends' kernels
+// but the colors, the fixed point ones also against the double-double image of the same backend.
+// the exit code is 1 when any of them diverges while the view is shallow enough for double.
+// --alloc-check replaces the benchmark by a check that interactive navigation doesn't allocate,
+// in a hidden window with the GUI drawn over every frame like the interactive build does.
+// --reproject-check compares the vector reproject() with reprojectScalar() instead.
+
+using namespace std;
+
+static const char* usage =
+	"options:\n"
+	"  --views <a,b,..>        catalogue entries to run, all by default\n"
+	"  --sizes <WxH,..>        image sizes, 320x180,960x540 by default\n"
+	"  --iters <n,..>          iteration limits, 256,4096 by default\n"
+	"  --backends <b,..>       cpu, tbb, bignum; bignum only runs at the first size\n"
+	"  --precisions <p,..>     double, double-double, fixed by default\n"
+	"  --warmup <n>            untimed renders before measuring, 1 by default\n"
+	"  --repeat <n>            timed renders per case, 5 by default\n"
+	"  --threads <n>           worker threads for tbb and bignum, 0 for every core\n"
+	"  --tolerance <f>         fraction of pixels allowed to differ from a reference of the same\n"
+	"                          precision, 0.001 by default\n"
+	"  --cross-tolerance <f>   the same for the higher precisions against the double reference, where\n"
+	"                          long orbits near the boundary legitimately escape elsewhere, 0.01 by default\n"
+	"  --perf <0|1>            read hardware counters around the renders, Linux only, off by default\n"
+	"  --huge-pages <0|1>      back the per pixel bookkeeping with large pages where the OS allows it\n"
+	"  --alloc-check <n>       instead of benchmarking, pan and zoom for n frames on every backend at\n"
+	"                          the first view and size in a hidden window with the GUI, and fail on\n"
+	"                          any operator new; malloc, and so SDL, ImGui and TBB, is not counted\n"
+	"  --reproject-check <n>   instead of benchmarking, reproject a random image with n random zooms and\n"
+	"                          pans, and fail unless reproject() matches reprojectScalar() bit for bit\n"
+	"  --json <file>           write the results as JSON\n";
+
+// a pixel counts as different once any channel is off by more than this
+static constexpr int pixel_threshold = 16;
+
+// below this many ulps of the center per pixel, double no longer tells the pixels apart and only
+// the higher precisions are right: the divergences are reported but don't fail
+static constexpr double min_reference_ulps = 64.;
+
+struct BenchResult
+{
+	string   view;
+	int      width  = 0;
+	int      height = 0;
+	uint32_t iter   = 0;
+	string   backend;
+	string   precision;
+
+	vector<double> times = {}; // seconds
+	uint64_t iterations = 0;
+	double   divergence = 0.; // from the double reference
+	double   cross      = 0.; // fixed point from the backend's double-double image, 0 for the others
+	PerfSample perf = {}; // summed over the timed runs, empty without --perf
+
+	double median() const
+	{
+		auto sorted = times;
+		sort(sorted.begin(), sorted.end());
+		auto n = sorted.size();
+		return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.;
+	}
+	double min() const { return *min_element(times.begin(), times.end()); }
+	double mean() const { return accumulate(times.begin(), times.end(), 0.) / times.size(); }
+	double stddev() const
+	{
+		double m = mean(), sum = 0.;
+		for (auto t : times) sum += (t - m) * (t - m);
+		return times.size() > 1 ? sqrt(sum / (times.size() - 1)) : 0.;
+	}
+};
+
+static vector<string> split(const string& list)
+{
+	vector<string> items;
+	stringstream ss(list);
+	for (string item; getline(ss, item, ',');)
+		if (!item.empty()) items.push_back(item);
+	return items;
+}
+
+static vector<uint32_t> copyPixels(const SDL_Surface* surface)
+{
+	auto* pixels = (const uint32_t*)surface->pixels;
+	return vector<uint32_t>(pixels, pixels + surface->w * surface->h);
+}
+
+static double compare(const vector<uint32_t>& a, const vector<uint32_t>& b)
+{
+	size_t differ = 0;
+	for (size_t i = 0; i < a.size(); ++i) {
+		for (int shift = 0; shift < 24; shift += 8) {
+			int ca = (a[i] >> shift) & 0xff, cb = (b[i] >> shift) & 0xff;
+			if (abs(ca - cb) > pixel_threshold) {
+				++differ;
+				break;
+			}
+		}
+	}
+	return (double)differ / a.size();
+}
+
+// the image every backend should come close to, from a scalar double loop that only borrows the
+// colors from mandelbrot. pixel (w, h) is sampled at (min_x + dx * (w + 0.5), max_y - dy * (h + 0.5))
+// like the backends do, c a rounding off would send the long orbits elsewhere.
+static vector<uint32_t> renderReference(const Mandelbrot& mandelbrot)
+{
+	int    width = mandelbrot.getWidth(), height = mandelbrot.getHeight();
+	auto   iter  = mandelbrot.getIteration();
+	double scale = mandelbrot.getScale();
+	double dx    = 4. * scale * ((double)width / height) / width;
+	double dy    = 4. * scale / height;
+
+	Mandelbrot::pos_t corner_x, corner_y;
+	mandelbrot.pixelToComplex(0., 0., corner_x, corner_y);
+	double min_x = (double)corner_x, max_y = (double)corner_y;
+
+	vector<uint32_t> pixels((size_t)width * height);
+	for (int h = 0; h < height; ++h) {
+		for (int w = 0; w < width; ++w) {
+			double cx = min_x + dx * (w + .5), cy = max_y - dy * (h + .5), zx = 0., zy = 0.;
+
+			uint32_t i = 0;
+			for (;;) {
+				double x = zx * zx - zy * zy + cx;
+				zy       = 2. * zx * zy + cy;
+				zx       = x;
+				if (zx * zx + zy * zy >= 65536. || ++i >= iter) break;
+			}
+			pixels[(size_t)h * width + w] = mandelbrot.getColor(i, zx, zy);
+		}
+	}
+	return pixels;
+}
+
+// whether double spaces the pixel centers of the view far enough apart to stand as its reference
+static bool resolvesInDouble(const Mandelbrot& mandelbrot)
+{
+	auto   c   = mandelbrot.getPosition();
+	double dx  = 4. * mandelbrot.getScale() / mandelbrot.getHeight();
+	double ulp = DBL_EPSILON * SDL_max(SDL_max(fabs(c.real()), fabs(c.imag())) + 2. * mandelbrot.getScale(), DBL_MIN);
+	return dx >= min_reference_ulps * ulp;
+}
+
+static string escape(const string& s)
+{
+	string result;
+	for (char c : s) {
+		if (c == '"' || c == '\\') result += '\\';
+		result += c;
+	}
+	return result;
+}
+
+// the steady state of the GUI's main loop: a move or a zoom, then an async render that the next
+// input usually cancels, the GUI and the texture upload of draw(). the first frames may allocate
+// (the render thread, the adaptive queue, the GUI's plots), everything after them must not.
+static uint64_t checkAllocations(unique_ptr<Mandelbrot>& mandelbrot, GUI& gui, SDL_Renderer* renderer, int frames,
+	uint64_t& bytes)
+{
+	FrameMetrics metrics;
+	mandelbrot->setMetrics(&metrics);
+
+	auto w = mandelbrot->getWidth(), h = mandelbrot->getHeight();
+	auto navigate = [&](int frame) {
+		for (SDL_Event e; SDL_PollEvent(&e);) gui.processEvent(&e);
+
+		switch (frame % 4) {
+		case 0: mandelbrot->move(3, 2); break;
+		case 1: mandelbrot->setScaleTo(mandelbrot->getScale() / 1.05, w / 3, h / 2); break;
+		case 2: mandelbrot->move(-3, -2); break;
+		case 3: mandelbrot->setScaleTo(mandelbrot->getScale() * 1.05, w / 3, h / 2); break;
+		}
+		mandelbrot->render(true);
+		if (frame % 8 == 7) mandelbrot->wait(); // sometimes the frame completes
+
+		gui.update(mandelbrot);
+		gui.render();
+		mandelbrot->draw();
+		gui.draw();
+		SDL_RenderPresent(renderer);
+		Time::update();
+	};
+
+	for (int frame = 0; frame < 16; ++frame) navigate(frame);
+	mandelbrot->wait();
+
+	auto count = AllocCounter::getCount();
+	bytes      = AllocCounter::getBytes();
+
+	for (int frame = 0; frame < frames; ++frame) navigate(frame);
+	mandelbrot->wait();
+
+	bytes = AllocCounter::getBytes() - bytes;
+	count = AllocCounter::getCount() - count;
+
+	mandelbrot->stop();
+	mandelbrot->setMetrics(nullptr);
+	return count;
+}
+
+// the sizes are odd so that the spans start and end anywhere in the 8 pixel steps of the vector
+// path, the mappings zoom up to 4x either way and overlap the source anywhere from fully to not at all
+static int checkReprojection(int mappings)
+{
+	mt19937 rng(1);
+	uniform_real_distribution<double> unit(0., 1.);
+
+	auto* src    = SDL_CreateRGBSurface(0, 643, 359, 32, 0, 0, 0, 0);
+	auto* vector = SDL_CreateRGBSurface(0, 641, 361, 32, 0, 0, 0, 0);
+	auto* scalar = SDL_CreateRGBSurface(0, 641, 361, 32, 0, 0, 0, 0);
+
+	auto* pixels = (uint32_t*)src->pixels;
+	for (int i = 0; i < src->w * src->h; ++i) pixels[i] = (uint32_t)rng();
+
+	int failed = 0;
+	for (int i = 0; i < mappings; ++i) {
+		Reprojection r;
+		r.scale_x  = exp2(unit(rng) * 4. - 2.);
+		r.scale_y  = i % 4 ? r.scale_x : exp2(unit(rng) * 4. - 2.); // mostly zooms, some stretches
+		r.offset_x = unit(rng) * (src->w + vector->w * r.scale_x) - vector->w * r.scale_x;
+		r.offset_y = unit(rng) * (src->h + vector->h * r.scale_y) - vector->h * r.scale_y;
+
+		reproject(src, vector, r);
+		reprojectScalar(src, scalar, r);
+
+		auto* a = (const uint32_t*)vector->pixels;
+		auto* b = (const uint32_t*)scalar->pixels;
+		auto differ = (int)inner_product(a, a + vector->w * vector->h, b, 0, plus<>(), not_equal_to<>());
+		if (differ) {
+			printf("FAILED: scale (%g, %g), offset (%g, %g), %d pixels differ\n", r.scale_x, r.scale_y, r.offset_x,
+				r.offset_y, differ);
+			++failed;
+		}
+	}
+	printf("reproject: %d of %d mappings differ from the scalar path\n", failed, mappings);
+
+	SDL_FreeSurface(src);
+	SDL_FreeSurface(vector);
+	SDL_FreeSurface(scalar);
+	return failed;
+}
+
+static bool writeJson(const string& path, const vector<BenchResult>& results, int repeat, int warmup, double tolerance,
+	double cross_tolerance)
+{
+	ofstream file(path);
+	file.precision(6);
+
+	file << "{\n";
+	file << "  \"hardware_threads\": " << thread::hardware_concurrency() << ",\n";
+	file << "  \"warmup\": " << warmup << ",\n";
+	file << "  \"repeat\": " << repeat << ",\n";
+	file << "  \"tolerance\": " << tolerance << ",\n";
+	file << "  \"cross_tolerance\": " << cross_tolerance << ",\n";
+	file << "  \"results\": [\n";
+
+	for (size_t i = 0; i < results.size(); ++i) {
+		auto& r = results[i];
+		double pixels = (double)r.width * r.height, t = r.median();
+
+		file << "    { \"view\": \"" << escape(r.view) << "\", \"width\": " << r.width << ", \"height\": " << r.height
+		     << ", \"iter\": " << r.iter << ", \"backend\": \"" << r.backend << "\", \"precision\": \"" << r.precision << "\",\n";
+		file << "      \"median_ms\": " << t * 1e3 << ", \"min_ms\": " << r.min() * 1e3 << ", \"mean_ms\": " << r.mean() * 1e3
+		     << ", \"stddev_ms\": " << r.stddev() * 1e3 << ",\n";
+		file << "      \"mpixel_s\": " << pixels / t / 1e6 << ", \"giter_s\": " << r.iterations / t / 1e9
+		     << ", \"iterations\": " << r.iterations << ", \"divergence\": " << r.divergence
+		     << ", \"cross_precision\": " << r.cross;
+		if (!r.perf.empty()) {
+			file << ",\n      \"cycles\": " << r.perf.cycles << ", \"instructions\": " << r.perf.instructions
+			     << ", \"ipc\": " << r.perf.getIPC() << ", \"branch_miss_rate\": " << r.perf.getBranchMissRate()
+			     << ", \"cache_miss_rate\": " << r.perf.getCacheMissRate();
+		}
+		file << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+
+	file << "  ]\n}\n";
+	return file.good();
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> views, sizes = { "320x180", "960x540" }, iters = { "256", "4096" };
+	vector<string> backends = { "cpu", "tbb", "bignum" }, precisions = { "double", "double-double", "fixed" };
+	int warmup = 1, repeat = 5;
+	uint32_t threads = 0;
+	double tolerance = 0.001, cross_tolerance = 0.01;
+	bool perf = false, huge_pages = false;
+	int alloc_check = 0, reproject_check = 0;
+	string json;
+
+	for (auto& view : bench_views) views.push_back(view.name);
+
+	for (int i = 1; i < argc; ++i) {
+		string key = argv[i];
+		if (key == "--help" || i + 1 == argc) {
+			cout << "usage: " << argv[0] << " [options]\n" << usage;
+			return key == "--help" ? 0 : -1;
+		}
+		string value = argv[++i];
+
+		bool ok = true;
+		if      (key == "--views")      views      = split(value);
+		else if (key == "--sizes")      sizes      = split(value);
+		else if (key == "--iters")      iters      = split(value);
+		else if (key == "--backends")   backends   = split(value);
+		else if (key == "--precisions") precisions = split(value);
+		else if (key == "--warmup")     ok = (istringstream(value) >> warmup) && warmup >= 0;
+		else if (key == "--repeat")     ok = (istringstream(value) >> repeat) && repeat > 0;
+		else if (key == "--threads")    ok = !!(istringstream(value) >> threads);
+		else if (key == "--tolerance")  ok = (istringstream(value) >> tolerance) && tolerance >= 0.;
+		else if (key == "--cross-tolerance") ok = (istringstream(value) >> cross_tolerance) && cross_tolerance >= 0.;
+		else if (key == "--perf")       ok = !!(istringstream(value) >> perf);
+		else if (key == "--huge-pages") ok = !!(istringstream(value) >> huge_pages);
+		else if (key == "--alloc-check") ok = (istringstream(value) >> alloc_check) && alloc_check >= 0;
+		else if (key == "--reproject-check") ok = (istringstream(value) >> reproject_check) && reproject_check >= 0;
+		else if (key == "--json")       json = value;
+		else ok = false;
+
+		if (!ok) {
+			cout << "error: invalid option " << key << " " << value << "\n\n" << usage;
+			return -1;
+		}
+	}
+
+	// the counters stay off when they can't be read, the timings are still worth having
+	if (perf && !PerfCounters::available()) {
+		cout << "warning: no hardware counters, " << PerfCounters::getError() << "\n\n";
+		perf = false;
+	}
+	PerfCounters::setEnabled(perf);
+	Mandelbrot::setHugePages(huge_pages);
+
+	// every case is a ViewSpec, so the names and sizes are validated the same way the headless renderer does
+	auto makeSpec = [&](const BenchView& view, const string& size, const string& iter, const string& backend,
+		const string& precision, ViewSpec& spec) {
+		string error;
+		spec.threads = threads;
+		bool ok = spec.set("x", view.x, error) && spec.set("y", view.y, error) && spec.set("size", size, error) &&
+			spec.set("iter", iter, error) && spec.set("backend", backend, error) && spec.set("precision", precision, error);
+		spec.scale = view.scale;
+		if (!ok) cout << "error: " << error << "\n";
+		return ok;
+	};
+
+	// the scalar reference per (view, size, iter), and the double-double images per (view, size, iter, backend)
+	map<string, vector<uint32_t>> references, double_doubles;
+	auto getReference = [&](const Mandelbrot& mandelbrot, const string& key) -> const vector<uint32_t>& {
+		auto it = references.find(key);
+		if (it != references.end()) return it->second;
+		return references[key] = renderReference(mandelbrot);
+	};
+
+	if (reproject_check > 0) return checkReprojection(reproject_check) ? 1 : 0;
+
+	vector<BenchResult> results;
+	int failed = 0;
+
+	if (alloc_check > 0) {
+		auto view = find_if(begin(bench_views), end(bench_views), [&](const BenchView& v) { return views[0] == v.name; });
+		if (view == end(bench_views)) {
+			cout << "error: unknown view \"" << views[0] << "\"\n";
+			return -1;
+		}
+
+		if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+			cout << "error: " << SDL_GetError() << "\n";
+			return -1;
+		}
+		Time::fps_limit = 1000000; // as fast as the frames go
+
+		printf("counting operator new, malloc (SDL, ImGui, TBB) is not counted\n");
+		for (auto& backend : backends) {
+			ViewSpec spec;
+			if (!makeSpec(*view, sizes[0], iters[0], backend, backend == "bignum" ? "fixed" : precisions[0], spec))
+				return -1;
+
+			auto* window   = SDL_CreateWindow("alloc check", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+				spec.width, spec.height, SDL_WINDOW_HIDDEN);
+			auto* renderer = window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED) : nullptr;
+			if (!renderer) {
+				cout << "error: " << SDL_GetError() << "\n";
+				return -1;
+			}
+
+			uint64_t count, bytes;
+			{
+				auto mandelbrot = spec.create(renderer);
+				GUI  gui(renderer);
+				gui.settings.accelerator = spec.backend == ViewSpec::Backend::CPU ? GUI::Acc::CPU :
+					spec.backend == ViewSpec::Backend::CPU_TBB ? GUI::Acc::CPU_TBB : GUI::Acc::CPU_BIGNUM;
+				gui.settings.auto_iter   = false; // keep the iteration limit of the view
+
+				count = checkAllocations(mandelbrot, gui, renderer, alloc_check, bytes);
+			}
+			SDL_DestroyRenderer(renderer);
+			SDL_DestroyWindow(window);
+
+			printf("%-7s %llu allocations (%llu bytes) over %d frames\n", backend.c_str(), (unsigned long long)count,
+				(unsigned long long)bytes, alloc_check);
+
+			if (count) {
+				printf("FAILED: %s allocates while navigating\n", backend.c_str());
+				++failed;
+			}
+		}
+
+		SDL_Quit();
+		return failed ? 1 : 0;
+	}
+
+	printf("%-9s %-9s %5s %-7s %-13s %9s %9s %9s %9s %7s %7s\n",
+		"view", "size", "iter", "backend", "precision", "median", "stddev", "Mpixel/s", "Giter/s", "diff", "cross");
+
+	for (auto& name : views) {
+		auto view = find_if(begin(bench_views), end(bench_views), [&](const BenchView& v) { return name == v.name; });
+		if (view == end(bench_views)) {
+			cout << "error: unknown view \"" << name << "\"\n";
+			return -1;
+		}
+
+		for (size_t s = 0; s < sizes.size(); ++s)
+		for (auto& iter : iters)
+		for (auto& backend : backends) {
+			// the bignum backend picks its own width, it is measured once as the reference it stands for
+			bool bignum = backend == "bignum";
+			if (bignum && s > 0) continue;
+
+			for (auto& precision : bignum ? vector<string>{ "fixed" } : precisions) {
+				ViewSpec spec;
+				if (!makeSpec(*view, sizes[s], iter, backend, precision, spec)) return -1;
+
+				auto mandelbrot = spec.createHeadless();
+
+				FrameMetrics metrics;
+				if (perf) mandelbrot->setMetrics(&metrics);
+
+				BenchResult result{ view->name, spec.width, spec.height, spec.iter, backend,
+					bignum ? "bignum" : ViewSpec::getName(mandelbrot->getActivePrecision()) };
+
+				for (int run = -warmup; run < repeat; ++run) {
+					spec.apply(*mandelbrot); // invalidates the previous image
+
+					auto start = chrono::steady_clock::now();
+					mandelbrot->render(false);
+					chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+					if (run >= 0) result.times.push_back(elapsed.count());
+					if (run >= 0 && perf) result.perf += metrics.getLastFrame().perf;
+				}
+				result.iterations = mandelbrot->getIterationCount();
+
+				// the bignum backend has no double-double image of its own, it is held to the single-threaded one
+				auto key    = string(view->name) + "/" + sizes[s] + "/" + iter;
+				auto dd_key = key + "/" + (bignum ? "cpu" : backend);
+				auto pixels = copyPixels(mandelbrot->getSurface());
+				result.divergence = compare(pixels, getReference(*mandelbrot, key));
+
+				auto active = mandelbrot->getActivePrecision();
+				bool fixed  = bignum || active >= Mandelbrot::Precision::Fixed128;
+				if (!bignum && active == Mandelbrot::Precision::DoubleDouble) double_doubles[dd_key] = pixels;
+				auto dd = double_doubles.find(dd_key);
+				result.cross = fixed && dd != double_doubles.end() ? compare(pixels, dd->second) : 0.;
+
+				double t = result.median();
+				printf("%-9s %-9s %5u %-7s %-13s %7.2fms %7.2fms %9.2f %9.3f %6.3f%% %6.3f%%\n",
+					result.view.c_str(), sizes[s].c_str(), result.iter, backend.c_str(), result.precision.c_str(),
+					t * 1e3, result.stddev() * 1e3, (double)spec.width * spec.height / t / 1e6,
+					result.iterations / t / 1e9, result.divergence * 100., result.cross * 100.);
+				if (!result.perf.empty()) {
+					printf("%-9s IPC %.2f, branch misses %.2f%%, cache misses %.2f%%\n", "", result.perf.getIPC(),
+						result.perf.getBranchMissRate() * 100., result.perf.getCacheMissRate() * 100.);
+				}
+
+				bool above_double = bignum || active != Mandelbrot::Precision::Double;
+				if (resolvesInDouble(*mandelbrot)) {
+					if (result.divergence > (above_double ? cross_tolerance : tolerance)) {
+						printf("FAILED: %s differs from the double reference in %.3f%% of the pixels\n",
+							backend.c_str(), result.divergence * 100.);
+						++failed;
+					}
+					if (result.cross > tolerance) {
+						printf("FAILED: %s at %s differs from its double-double image in %.3f%% of the pixels\n",
+							backend.c_str(), result.precision.c_str(), result.cross * 100.);
+						++failed;
+					}
+				}
+
+				results.push_back(move(result));
+			}
+		}
+	}
+
+	if (!json.empty() && !writeJson(json, results, repeat, warmup, tolerance, cross_tolerance)) {
+		cout << "error: couldn't write " << json << "\n";
+		return -1;
+	}
+
+	if (failed) {
+		printf("\n%d case(s) FAILED, outputs diverge from the references\n", failed);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// the views the benchmarking tools render, centers as strings so the deep one keeps its digits
+// through ViewSpec::set
+struct BenchView
+{
+	const char* name;
+	const char* x;
+	const char* y;
+	double      scale;
+};
+
+inline const BenchView bench_views[] = {
+	{ "home",      "-0.5",               "0",                  1.2    }, // the whole set, mixed
+	{ "seahorse",  "-0.7453",            "0.1127",             6.5e-3 }, // filaments, long orbits near the boundary
+	{ "needle",    "-1.99999911758738",  "0",                  1e-11  }, // deep on the real axis, exercises the precision switch
+	{ "interior",  "-0.1",               "0",                  0.05   }, // inside the main cardioid, every pixel hits the limit
+	{ "exterior",  "0.9",                "0.9",                0.3    }, // almost everything escapes in a few iterations
+	{ "wide",      "0",                  "0",                  6.     }  // zoomed far out, c reaches past the [-8, 8) fixed point holds
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// the 64-bit intrinsics are x64 only, Win32 builds work on the two halves
+
+// index of the lowest set bit, x must not be 0
+inline int countTrailingZeros(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long idx;
+	_BitScanForward64(&idx, x);
+	return (int)idx;
+#elif defined(_MSC_VER)
+	unsigned long idx;
+	if (_BitScanForward(&idx, (unsigned long)x)) return (int)idx;
+	_BitScanForward(&idx, (unsigned long)(x >> 32));
+	return (int)idx + 32;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+
+inline int popCount(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	return (int)__popcnt64(x);
+#elif defined(_MSC_VER)
+	return (int)(__popcnt((unsigned int)x) + __popcnt((unsigned int)(x >> 32)));
+#else
+	return __builtin_popcountll(x);
+#endif
+}
+
+// bits [begin, end) of a 64-bit word, 0 <= begin <= end <= 64
+inline uint64_t bitRange(int begin, int end) {
+	uint64_t below_end = end >= 64 ? ~0ull : (1ull << end) - 1;
+	return below_end & ~((1ull << begin) - 1);
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cmath>
+#include <stdint.h>
+
+// double-double arithmetic: a value is the unevaluated sum hi + lo with |lo| <= ulp(hi) / 2,
+// giving ~106 bits of mantissa. every operation is built from the error-free transforms below,
+// so it costs a handful of FMAs instead of a generic bignum multiply.
+namespace dd {
+
+inline void two_sum(double a, double b, double& s, double& e) {
+	s = a + b;
+	double bb = s - a;
+	e = (a - (s - bb)) + (b - bb);
+}
+
+inline void quick_two_sum(double a, double b, double& s, double& e) { // requires |a| >= |b|
+	s = a + b;
+	e = b - (s - a);
+}
+
+inline void two_prod(double a, double b, double& p, double& e) {
+	p = a * b;
+	e = std::fma(a, b, -p);
+}
+
+inline void add(double ah, double al, double bh, double bl, double& rh, double& rl) {
+	double s, e;
+	two_sum(ah, bh, s, e);
+	e += al + bl;
+	quick_two_sum(s, e, rh, rl);
+}
+
+inline void mul(double ah, double al, double bh, double bl, double& rh, double& rl) {
+	double p, e;
+	two_prod(ah, bh, p, e);
+	e += ah * bl + al * bh;
+	quick_two_sum(p, e, rh, rl);
+}
+
+inline void sqr(double ah, double al, double& rh, double& rl) {
+	double p, e;
+	two_prod(ah, ah, p, e);
+	e += 2. * ah * al;
+	quick_two_sum(p, e, rh, rl);
+}
+
+} // namespace dd
+
+struct dd_real {
+	double hi;
+	double lo;
+
+	constexpr dd_real(double hi = 0., double lo = 0.) : hi(hi), lo(lo) {}
+
+	explicit operator double() const { return hi + lo; }
+
+	inline dd_real& operator+=(const dd_real& rhs);
+	inline dd_real& operator-=(const dd_real& rhs);
+	inline dd_real& operator*=(const dd_real& rhs);
+};
+
+inline dd_real operator-(const dd_real& a) {
+	return { -a.hi, -a.lo };
+}
+
+inline dd_real operator+(const dd_real& a, const dd_real& b) {
+	dd_real r;
+	dd::add(a.hi, a.lo, b.hi, b.lo, r.hi, r.lo);
+	return r;
+}
+
+inline dd_real operator-(const dd_real& a, const dd_real& b) {
+	dd_real r;
+	dd::add(a.hi, a.lo, -b.hi, -b.lo, r.hi, r.lo);
+	return r;
+}
+
+inline dd_real operator*(const dd_real& a, const dd_real& b) {
+	dd_real r;
+	dd::mul(a.hi, a.lo, b.hi, b.lo, r.hi, r.lo);
+	return r;
+}
+
+inline dd_real operator*(double a, const dd_real& b) {
+	dd_real r;
+	dd::mul(a, 0., b.hi, b.lo, r.hi, r.lo);
+	return r;
+}
+
+inline dd_real operator*(const dd_real& a, double b) { return b * a; }
+
+// long division, one correction step per extra double of quotient
+inline dd_real operator/(const dd_real& a, const dd_real& b) {
+	double q1 = a.hi / b.hi;
+	dd_real r = a - q1 * b;
+	double q2 = r.hi / b.hi;
+	r         = r - q2 * b;
+	double q3 = r.hi / b.hi;
+
+	dd_real q;
+	dd::quick_two_sum(q1, q2, q.hi, q.lo);
+	return q + dd_real(q3);
+}
+
+inline dd_real& dd_real::operator+=(const dd_real& rhs) { return *this = *this + rhs; }
+inline dd_real& dd_real::operator-=(const dd_real& rhs) { return *this = *this - rhs; }
+inline dd_real& dd_real::operator*=(const dd_real& rhs) { return *this = *this * rhs; }
+
+inline bool operator<(const dd_real& a, const dd_real& b) {
+	return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+inline bool operator>(const dd_real& a, const dd_real& b) { return b < a; }
+inline bool operator<=(const dd_real& a, const dd_real& b) { return !(b < a); }
+inline bool operator>=(const dd_real& a, const dd_real& b) { return !(a < b); }
+
+inline bool operator==(const dd_real& a, const dd_real& b) {
+	return a.hi == b.hi && a.lo == b.lo;
+}
+
+inline dd_real abs(const dd_real& a) {
+	return a.hi < 0. ? -a : a;
+}
+
+// iterates N points at once with hi and lo parts kept in separate arrays, so every
+// step is a straight-line loop over lanes that the compiler turns into packed FMAs.
+// escaped lanes are frozen and the batch ends once every lane is done.
+template <int N>
+inline void mandelbrot_soa(const dd_real* c_x, const dd_real* c_y, uint32_t max_iter, uint32_t* iterated, double* z_x, double* z_y)
+{
+	alignas(64) double cx_hi[N], cx_lo[N], cy_hi[N], cy_lo[N];
+	alignas(64) double zx_hi[N], zx_lo[N], zy_hi[N], zy_lo[N];
+	alignas(64) uint32_t count[N];
+
+	for (int l = 0; l < N; ++l) {
+		cx_hi[l] = c_x[l].hi; cx_lo[l] = c_x[l].lo;
+		cy_hi[l] = c_y[l].hi; cy_lo[l] = c_y[l].lo;
+		zx_hi[l] = zx_lo[l] = zy_hi[l] = zy_lo[l] = 0.;
+		count[l] = 0;
+	}
+
+	for (uint32_t i = 0; i < max_iter; ++i) {
+		uint32_t active = 0;
+
+		for (int l = 0; l < N; ++l) {
+			double x2h, x2l, y2h, y2l, xyh, xyl, xh, xl, yh, yl;
+
+			dd::sqr(zx_hi[l], zx_lo[l], x2h, x2l);
+			dd::sqr(zy_hi[l], zy_lo[l], y2h, y2l);
+			dd::mul(zx_hi[l], zx_lo[l], zy_hi[l], zy_lo[l], xyh, xyl);
+
+			dd::add(x2h, x2l, -y2h, -y2l, xh, xl);
+			dd::add(xh, xl, cx_hi[l], cx_lo[l], xh, xl);
+			dd::add(2. * xyh, 2. * xyl, cy_hi[l], cy_lo[l], yh, yl);
+
+			// a lane stays live while it has not escaped; escaped lanes keep their last z
+			bool live = count[l] == i && zx_hi[l] * zx_hi[l] + zy_hi[l] * zy_hi[l] < 65536.;
+
+			zx_hi[l] = live ? xh : zx_hi[l];
+			zx_lo[l] = live ? xl : zx_lo[l];
+			zy_hi[l] = live ? yh : zy_hi[l];
+			zy_lo[l] = live ? yl : zy_lo[l];
+			count[l] += live;
+			active   += live;
+		}
+
+		if (!active) break;
+	}
+
+	for (int l = 0; l < N; ++l) {
+		// match mandelbrot<T>: the reported count excludes the step that escaped
+		bool escaped = zx_hi[l] * zx_hi[l] + zy_hi[l] * zy_hi[l] >= 65536.;
+		iterated[l]  = escaped && count[l] > 0 ? count[l] - 1 : count[l];
+		z_x[l]       = zx_hi[l] + zx_lo[l];
+		z_y[l]       = zy_hi[l] + zy_lo[l];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <stdint.h>
+#include <cmath>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#include "dd_real.h"
+
+namespace fixed {
+
+// 64 x 64 -> 128 bit multiply, returns the low half. MSVC has no __int128, so x64 gets _umul128
+// and 32-bit targets add up four 32 x 32 products.
+inline uint64_t mul_wide(uint64_t a, uint64_t b, uint64_t& hi) {
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+	return _umul128(a, b, &hi);
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 p = (unsigned __int128)a * b;
+	hi = (uint64_t)(p >> 64);
+	return (uint64_t)p;
+#else
+	uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+	uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+
+	uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo, hh = a_hi * b_hi;
+	uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl; // below 2^34, no carry lost
+
+	hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | (uint32_t)ll;
+#endif
+}
+
+inline uint64_t add_carry(uint64_t a, uint64_t b, uint64_t& carry) {
+	uint64_t s = a + carry;
+	uint64_t c = s < carry;
+	uint64_t r = s + b;
+	carry = c + (r < b);
+	return r;
+}
+
+inline uint64_t sub_borrow(uint64_t a, uint64_t b, uint64_t& borrow) {
+	uint64_t d = a - borrow;
+	uint64_t c = a < borrow;
+	uint64_t r = d - b;
+	borrow = c + (d < b);
+	return r;
+}
+
+} // namespace fixed
+
+// signed Q4.(64N-4) fixed-point number: N 64-bit limbs of two's complement, least significant first.
+// 128/192/256-bit formats are N = 2/3/4, wider ones serve as the reference bignum. every operation
+// is exact integer arithmetic, so results are bit-identical on every compiler and machine.
+template <int N>
+struct fixed_t {
+	static constexpr int frac_bits = 64 * N - 4;
+
+	uint64_t limb[N];
+
+	fixed_t() : limb{} {}
+	explicit fixed_t(double v);
+	explicit fixed_t(const dd_real& v);
+	explicit operator double() const;
+
+	inline bool negative() const { return (int64_t)limb[N - 1] < 0; }
+	inline int64_t top() const { return (int64_t)limb[N - 1]; }
+};
+
+template <int N>
+inline fixed_t<N> operator+(const fixed_t<N>& a, const fixed_t<N>& b) {
+	fixed_t<N> r;
+	uint64_t carry = 0;
+	for (int i = 0; i < N; ++i)
+		r.limb[i] = fixed::add_carry(a.limb[i], b.limb[i], carry);
+	return r;
+}
+
+template <int N>
+inline fixed_t<N> operator-(const fixed_t<N>& a, const fixed_t<N>& b) {
+	fixed_t<N> r;
+	uint64_t borrow = 0;
+	for (int i = 0; i < N; ++i)
+		r.limb[i] = fixed::sub_borrow(a.limb[i], b.limb[i], borrow);
+	return r;
+}
+
+template <int N>
+inline fixed_t<N> operator-(const fixed_t<N>& a) {
+	return fixed_t<N>() - a;
+}
+
+template <int N>
+inline fixed_t<N> abs(const fixed_t<N>& a) {
+	return a.negative() ? -a : a;
+}
+
+// full 2N-limb product of two magnitudes
+template <int N>
+inline void mul_full(const uint64_t* a, const uint64_t* b, uint64_t* p) {
+	for (int i = 0; i < 2 * N; ++i) p[i] = 0;
+
+	for (int i = 0; i < N; ++i) {
+		uint64_t carry = 0;
+		for (int j = 0; j < N; ++j) {
+			uint64_t hi, lo = fixed::mul_wide(a[i], b[j], hi);
+			uint64_t c  = 0;
+			lo          = fixed::add_carry(lo, p[i + j], c);
+			hi         += c;
+			c           = 0;
+			p[i + j]    = fixed::add_carry(lo, carry, c);
+			carry       = hi + c;
+		}
+		p[i + N] = carry;
+	}
+}
+
+// squaring only needs the upper triangle of partial products, doubled, plus the diagonal
+template <int N>
+inline void sqr_schoolbook(const uint64_t* a, uint64_t* p) {
+	for (int i = 0; i < 2 * N; ++i) p[i] = 0;
+
+	for (int i = 0; i < N; ++i) {
+		uint64_t carry = 0;
+		for (int j = i + 1; j < N; ++j) {
+			uint64_t hi, lo = fixed::mul_wide(a[i], a[j], hi);
+			uint64_t c  = 0;
+			lo          = fixed::add_carry(lo, p[i + j], c);
+			hi         += c;
+			c           = 0;
+			p[i + j]    = fixed::add_carry(lo, carry, c);
+			carry       = hi + c;
+		}
+		p[i + N] = carry;
+	}
+
+	uint64_t shifted = 0;
+	for (int i = 0; i < 2 * N; ++i) {
+		uint64_t v = p[i];
+		p[i]       = (v << 1) | shifted;
+		shifted    = v >> 63;
+	}
+
+	uint64_t carry = 0;
+	for (int i = 0; i < N; ++i) {
+		uint64_t hi, lo = fixed::mul_wide(a[i], a[i], hi);
+		p[2 * i]        = fixed::add_carry(p[2 * i], lo, carry);
+		p[2 * i + 1]    = fixed::add_carry(p[2 * i + 1], hi, carry);
+	}
+}
+
+// from this many limbs on, squaring splits a = a1 * B^h + a0 and recurses (Karatsuba):
+// a^2 = a1^2 * B^2h + (a0^2 + a1^2 - (a0 - a1)^2) * B^h + a0^2, three half-size squares.
+// all scratch lives on the stack, so the orbit loop never touches the heap.
+constexpr int karatsuba_limbs = 8;
+
+template <int N>
+inline void sqr_full(const uint64_t* a, uint64_t* p) {
+	if constexpr (N >= karatsuba_limbs && N % 2 == 0) {
+		constexpr int H = N / 2;
+
+		uint64_t mid[N], diff[H];
+		sqr_full<H>(a, p);          // a0^2 -> p[0, N)
+		sqr_full<H>(a + H, p + N);  // a1^2 -> p[N, 2N)
+
+		bool a0_less = false;
+		for (int i = H - 1; i >= 0; --i) {
+			if (a[i] != a[i + H]) {
+				a0_less = a[i] < a[i + H];
+				break;
+			}
+		}
+
+		uint64_t borrow = 0;
+		for (int i = 0; i < H; ++i)
+			diff[i] = a0_less ? fixed::sub_borrow(a[i + H], a[i], borrow) : fixed::sub_borrow(a[i], a[i + H], borrow);
+		sqr_full<H>(diff, mid);
+
+		// cross = a0^2 + a1^2 - (a0 - a1)^2 = 2 * a0 * a1, N + 1 limbs
+		uint64_t cross[N + 1], carry = 0;
+		for (int i = 0; i < N; ++i)
+			cross[i] = fixed::add_carry(p[i], p[i + N], carry);
+		cross[N] = carry;
+
+		borrow = 0;
+		for (int i = 0; i < N; ++i)
+			cross[i] = fixed::sub_borrow(cross[i], mid[i], borrow);
+		cross[N] -= borrow;
+
+		carry = 0;
+		for (int i = 0; i <= N; ++i)
+			p[i + H] = fixed::add_carry(p[i + H], cross[i], carry);
+		for (int i = N + H + 1; carry && i < 2 * N; ++i)
+			p[i] = fixed::add_carry(p[i], 0, carry);
+	} else {
+		sqr_schoolbook<N>(a, p);
+	}
+}
+
+// keeps bits [frac_bits, frac_bits + 64N) of the product, i.e. drops 64N - 4 fraction bits
+template <int N>
+inline fixed_t<N> from_product(const uint64_t* p, bool negate) {
+	fixed_t<N> r;
+	for (int i = 0; i < N; ++i)
+		r.limb[i] = (p[i + N - 1] >> 60) | (p[i + N] << 4);
+	return negate ? -r : r;
+}
+
+template <int N>
+inline fixed_t<N> operator*(const fixed_t<N>& a, const fixed_t<N>& b) {
+	uint64_t p[2 * N];
+	auto ma = abs(a), mb = abs(b);
+	mul_full<N>(ma.limb, mb.limb, p);
+	return from_product<N>(p, a.negative() != b.negative());
+}
+
+template <int N>
+inline fixed_t<N> sqr(const fixed_t<N>& a) {
+	uint64_t p[2 * N];
+	auto ma = abs(a);
+	sqr_full<N>(ma.limb, p);
+	return from_product<N>(p, false);
+}
+
+template <int N>
+inline bool operator<(const fixed_t<N>& a, const fixed_t<N>& b) {
+	if (a.top() != b.top()) return a.top() < b.top();
+	for (int i = N - 2; i >= 0; --i)
+		if (a.limb[i] != b.limb[i]) return a.limb[i] < b.limb[i];
+	return false;
+}
+
+template <int N>
+fixed_t<N>::fixed_t(double v) : limb{}
+{
+	if (v == 0.) return;
+
+	int e;
+	double m = frexp(fabs(v), &e);            // |v| = m * 2^e, 0.5 <= m < 1
+	auto mant = (uint64_t)ldexp(m, 53);       // 53-bit integer mantissa
+	int shift = e - 53 + frac_bits;           // raw = mant << shift
+
+	if (shift < 0) {
+		if (shift <= -64) return;
+		mant >>= -shift;
+		shift = 0;
+	}
+
+	int idx = shift / 64, off = shift % 64;
+	if (idx < N) limb[idx] = mant << off;
+	if (off && idx + 1 < N) limb[idx + 1] = mant >> (64 - off);
+
+	if (v < 0.) *this = -*this;
+}
+
+template <int N>
+fixed_t<N>::fixed_t(const dd_real& v)
+{
+	*this = fixed_t<N>(v.hi) + fixed_t<N>(v.lo);
+}
+
+template <int N>
+fixed_t<N>::operator double() const
+{
+	auto m = abs(*this);
+	double r = 0.;
+	for (int i = 0; i < N; ++i)
+		r += ldexp((double)m.limb[i], 64 * i - frac_bits);
+	return negative() ? -r : r;
+}
+
+// the rest of an orbit that left the radius 2 disk at z = (x, y) after i iterations, in double up to
+// the usual 65536 bailout: the iteration count and the smooth coloring match mandelbrot<T>
+inline uint32_t mandelbrotTail(double x, double y, double cx, double cy, uint32_t i, uint32_t max_iter, double& zx_out, double& zy_out)
+{
+	while (x * x + y * y < 65536. && ++i < max_iter) {
+		double t = x * x - y * y + cx;
+		y = 2. * x * y + cy;
+		x = t;
+	}
+
+	zx_out = x;
+	zy_out = y;
+	return i;
+}
+
+// |z| < 2 before a step keeps every intermediate below 8, which is all Q4 can hold. so the orbit
+// runs in fixed point until it leaves the radius 2 disk, then finishes in mandelbrotTail.
+// c itself has to be inside [-8, 8), the overload on dd_real below takes any c.
+template <int N>
+inline uint32_t mandelbrot(const fixed_t<N>& cx, const fixed_t<N>& cy, uint32_t max_iter, double& zx_out, double& zy_out)
+{
+	constexpr int64_t two  = (int64_t)2 << 60;
+	constexpr int64_t four = (int64_t)4 << 60;
+
+	fixed_t<N> zx, zy, x2, y2;
+	uint32_t i = 0;
+
+	for (;;) {
+		auto xy = zx * zy;
+		zx = x2 - y2 + cx;
+		zy = xy + xy + cy;
+
+		if (zx.top() >= two || zx.top() <= -two || zy.top() >= two || zy.top() <= -two) break;
+
+		x2 = sqr(zx);
+		y2 = sqr(zy);
+		if ((x2 + y2).top() >= four) break;
+
+		if (++i >= max_iter) {
+			zx_out = (double)zx;
+			zy_out = (double)zy;
+			return i;
+		}
+	}
+
+	return mandelbrotTail((double)zx, (double)zy, (double)cx, (double)cy, i, max_iter, zx_out, zy_out);
+}
+
+// a c outside the radius 2 disk escapes at the first step, and from 8 on it would wrap around in
+// Q4, possibly into the set. it goes straight to the double tail from z = c, as the fixed-point
+// loop would send it.
+template <int N>
+inline uint32_t mandelbrot(const dd_real& cx, const dd_real& cy, uint32_t max_iter, double& zx_out, double& zy_out)
+{
+	double x = (double)cx, y = (double)cy;
+	if (x * x + y * y >= 4.) return mandelbrotTail(x, y, x, y, 0, max_iter, zx_out, zy_out);
+
+	return mandelbrot<N>(fixed_t<N>(cx), fixed_t<N>(cy), max_iter, zx_out, zy_out);
+}
\ No newline at end of file
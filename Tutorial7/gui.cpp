@@ -9,31 +9,32 @@
 #define STRINGIZE(x) STRINGIZE_DETAIL(x)
 #define IMGUI_NO_LABEL "##" STRINGIZE(__COUNTER__)
 
-#include <sstream>
+#include <cfloat>
 #include <imgui_impl_sdl2.h>
 #include <imgui_impl_sdlrenderer2.h>
 #include <stb_image_write.h>
 
 #include "mandelbrot_tbb.h"
 #include "mandelbrot_cuda.h"
+#include "mandelbrot_bignum.h"
+#include "view_spec.h"
+#include "alloc_counter.h"
 #include "time.h"
 
 using namespace std;
 
-static string getCaptureName() {
+static string getCaptureName(const char* extension = ".png") {
 	time_t now = time(0);
 	char buf[80];
 	tm tstruct;
 	localtime_s(&tstruct, &now);
-	strftime(buf, sizeof(buf), "%Y-%m-%d-%H-%M-%S.png", &tstruct);
-	return { buf };
+	strftime(buf, sizeof(buf), "%Y-%m-%d-%H-%M-%S", &tstruct);
+	return buf + string(extension);
 }
 
-template <class T>
-ostream& operator<<(ostream& os, complex<T> c) {
-	os << c.real() << (c.imag() < 0 ? " - " : " + ") << abs(c.imag()) << "i";
-	return os;
-}
+static const char* precision_names[] = {
+	"auto", "double", "double-double", "fixed-point", "fixed 128-bit", "fixed 192-bit", "fixed 256-bit"
+};
 
 GUI::GUI(SDL_Renderer* renderer)
 	: renderer(renderer)
@@ -52,6 +53,7 @@ GUI::GUI(SDL_Renderer* renderer)
 	settings.accelerator   = Acc::GPU_CUDA;
 	settings.move_speed    = 300.f;
 	settings.scroll_scale  = 1.1f;
+	settings.zoom_seconds  = .15f;
 	settings.render_async  = true;
 	settings.scaleToCursor = true;
 	settings.auto_iter     = true;
@@ -62,6 +64,17 @@ GUI::GUI(SDL_Renderer* renderer)
 	settings.capture_no_ui = true;
 
 	msg_timepoint = -3000;
+
+	plot.frames.reserve(FrameMetrics::window);
+	plot.uploads.reserve(FrameMetrics::window);
+	plot.render_ms.reserve(FrameMetrics::window);
+	plot.giter.reserve(FrameMetrics::window);
+	plot.tiles.reserve(Mandelbrot::max_tile_costs);
+
+	alloc_seen        = AllocCounter::getCount();
+	alloc_seen_bytes  = AllocCounter::getBytes();
+	alloc_frame_count = 0;
+	alloc_frame_bytes = 0;
 }
 
 GUI::~GUI()
@@ -88,6 +101,12 @@ bool GUI::keyCaptured() const
 
 void GUI::update(std::unique_ptr<Mandelbrot>& mandelbrot)
 {
+	// everything allocated since the last update, i.e. over one pass of the main loop
+	alloc_frame_count = AllocCounter::getCount() - alloc_seen;
+	alloc_frame_bytes = AllocCounter::getBytes() - alloc_seen_bytes;
+	alloc_seen        = AllocCounter::getCount();
+	alloc_seen_bytes  = AllocCounter::getBytes();
+
 	ImGui_ImplSDLRenderer2_NewFrame();
 	ImGui_ImplSDL2_NewFrame(window);
 	ImGui::NewFrame();
@@ -98,6 +117,7 @@ void GUI::update(std::unique_ptr<Mandelbrot>& mandelbrot)
 	showAppearanceUI(mandelbrot);
 	showMoreSettingsUI(mandelbrot);
 	showScreenshotUI(mandelbrot);
+	showMetricsUI(mandelbrot);
 
 	ImGui::SetWindowSize({ 260, ImGui::GetContentRegionAvail().y });
 
@@ -136,12 +156,11 @@ void GUI::postErrorMessage(const char* msg)
 
 void GUI::acceleratorChanged(std::unique_ptr<Mandelbrot>& mandelbrot)
 {
-	auto pos         = mandelbrot->getPosition();
-	auto scale       = mandelbrot->getScale();
-	auto iter        = mandelbrot->getIteration();
-	auto color_map   = mandelbrot->getColormap();
-	auto color_scale = mandelbrot->getColorScale();
-	auto smooth      = mandelbrot->getColorSmooth();
+	auto spec     = ViewSpec::capture(*mandelbrot);
+	auto overlay  = mandelbrot->getOverlay();
+	auto metrics  = mandelbrot->getMetrics();
+	auto prefetch = mandelbrot->getPrefetch();
+	auto budget   = mandelbrot->getPrefetchBudget();
 
 	mandelbrot->stop();
 
@@ -151,32 +170,40 @@ void GUI::acceleratorChanged(std::unique_ptr<Mandelbrot>& mandelbrot)
 		mandelbrot = make_unique<MandelbrotTBB>(renderer);
 	else if (settings.accelerator == Acc::GPU_CUDA)
 		mandelbrot = make_unique<MandelbrotCUDA>(renderer);
-
-	mandelbrot->setPosition(pos.real(), pos.imag());
-	mandelbrot->setScale(scale);
-	mandelbrot->setIteration(iter);
-	mandelbrot->setColormap(color_map);
-	mandelbrot->setColorScale(color_scale);
-	mandelbrot->setColorSmooth(smooth);
+	else if (settings.accelerator == Acc::CPU_BIGNUM)
+		mandelbrot = make_unique<MandelbrotBignum>(renderer);
+
+	spec.apply(*mandelbrot);
+	mandelbrot->setOverlay(overlay);
+	mandelbrot->setMetrics(metrics);
+	mandelbrot->setPrefetch(prefetch);
+	mandelbrot->setPrefetchBudget(budget);
 }
 
 void GUI::showBasicUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 {
-	stringstream ss;
 	int px, py, width, height;
 
 	SDL_GetMouseState(&px, &py);
 	SDL_GetWindowSize(window, &width, &height);
 
-	ss << "resolution: " << width << "X" << height << "\n";
-	ss << "mouse : (" << px << ", " << py << ")\n";
-	ss << "fps   : " << round(Time::fps * 10) / 10;
-	ss << "(" << round(10000. * Time::dt) / 10. << "ms)\n";
-	ss << "cursor: " << mandelbrot->pixelToComplex(px, py) << "\n";
-	ss << "pos   : " << mandelbrot->getPosition() << "\n";
-	ss << "scale : " << mandelbrot->getScale() << "\n";
-	ss << "iter  : " << mandelbrot->getIteration() << "\n";
-	ImGui::Text(ss.str().c_str());
+	// formatted by ImGui into its own buffer, nothing here allocates per frame
+	auto cursor = mandelbrot->pixelToComplex(px, py);
+	auto pos    = mandelbrot->getPosition();
+	ImGui::Text(
+		"resolution: %dX%d\n"
+		"mouse : (%d, %d)\n"
+		"fps   : %g(%gms)\n"
+		"cursor: %g %c %gi\n"
+		"pos   : %g %c %gi\n"
+		"scale : %g\n"
+		"iter  : %u\n"
+		"prec  : %s\n",
+		width, height, px, py, round(Time::fps * 10) / 10, round(10000. * Time::dt) / 10.,
+		cursor.real(), cursor.imag() < 0 ? '-' : '+', abs(cursor.imag()),
+		pos.real(), pos.imag() < 0 ? '-' : '+', abs(pos.imag()),
+		mandelbrot->getScale(), mandelbrot->getIteration(),
+		precision_names[(int)mandelbrot->getActivePrecision()]);
 
 	if (mandelbrot->isRendering())
 		ImGui::TextColored(ImColor(255, 0, 0), "rendering...");
@@ -187,6 +214,16 @@ void GUI::showBasicUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 		mandelbrot->setScale(1.);
 		mandelbrot->setIteration(32);
 	}
+
+	auto& finder = mandelbrot->getNucleusFinder();
+	if (ImGui::Button("snap to nearest minibrot"))
+		mandelbrot->findNucleus(width / 2, height / 2);
+
+	NucleusFinder::Candidate nucleus;
+	if (finder.isRunning())
+		ImGui::ProgressBar(finder.getProgress(), { -1, 0 }, "searching...");
+	else if (finder.getNearest(nucleus))
+		ImGui::Text("minibrot: period %u, size %.3g\n(%d found, N for cursor)", nucleus.period, nucleus.size, (int)finder.getCandidateCount());
 }
 
 void GUI::showMoreSettingsUI(std::unique_ptr<Mandelbrot>& mandelbrot)
@@ -198,6 +235,9 @@ void GUI::showMoreSettingsUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 		ImGui::Text("scroll scale :");
 		ImGui::SliderFloat(IMGUI_NO_LABEL, &settings.scroll_scale, 1.1f, 10.f, "%f", 32);
 
+		ImGui::Text("zoom animation (s) :");
+		ImGui::SliderFloat(IMGUI_NO_LABEL, &settings.zoom_seconds, 0.f, .5f);
+
 		ImGui::Checkbox("render async", &settings.render_async);
 
 		ImGui::Checkbox("scale to cursor", &settings.scaleToCursor);
@@ -220,13 +260,20 @@ void GUI::showMoreSettingsUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 void GUI::showAcceleratorUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 {
 	if (ImGui::CollapsingHeader("accelerator")) {
-		static const char* items[] = { "CPU", "CPU - TBB", "GPU - CUDA" };
+		static const char* items[] = { "CPU", "CPU - TBB", "GPU - CUDA", "CPU - bignum (reference)" };
 
 		ImGui::Text("accelerator :");
-		if (ImGui::Combo(IMGUI_NO_LABEL, (int*)&settings.accelerator, items, 3))
+		if (ImGui::Combo(IMGUI_NO_LABEL, (int*)&settings.accelerator, items, 4))
 			acceleratorChanged(mandelbrot);
 
-		if (settings.accelerator == Acc::CPU_TBB) {
+		if (settings.accelerator == Acc::CPU || settings.accelerator == Acc::CPU_TBB) {
+			auto precision = mandelbrot->getPrecision();
+			ImGui::Text("precision :");
+			if (ImGui::Combo(IMGUI_NO_LABEL, (int*)&precision, precision_names, 4))
+				mandelbrot->setPrecision(precision);
+		}
+
+		if (settings.accelerator == Acc::CPU_TBB || settings.accelerator == Acc::CPU_BIGNUM) {
 			auto* man_tbb = dynamic_cast<MandelbrotTBB*>(mandelbrot.get()); // will not fail
 			auto value    = (int)man_tbb->getMaxConcurrency();
 			ImGui::Text("max concurrency:");
@@ -234,6 +281,40 @@ void GUI::showAcceleratorUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 				value = SDL_clamp(value, 1, thread::hardware_concurrency());
 				man_tbb->setMaxConcurrency(value);
 			}
+
+			if (settings.accelerator == Acc::CPU_TBB) {
+				static const char* partitioners[] = { "auto", "simple", "static", "affinity" };
+
+				auto grain = (int)man_tbb->getGrainSize();
+				ImGui::Text("grain size:");
+				if (ImGui::InputInt(IMGUI_NO_LABEL, &grain, 1))
+					man_tbb->setGrainSize(SDL_clamp(grain, 1, 1024));
+
+				auto partitioner = man_tbb->getPartitioner();
+				ImGui::Text("partitioner:");
+				if (ImGui::Combo(IMGUI_NO_LABEL, (int*)&partitioner, partitioners, 4))
+					man_tbb->setPartitioner(partitioner);
+
+				auto autotune = man_tbb->getAutotune();
+				if (ImGui::Checkbox("autotune", &autotune))
+					man_tbb->setAutotune(autotune);
+
+				if (autotune) {
+					auto budget = man_tbb->getExploreBudget() * 100.f;
+					ImGui::Text("exploration budget:");
+					if (ImGui::SliderFloat(IMGUI_NO_LABEL, &budget, 1.f, 50.f, "%.0f%%"))
+						man_tbb->setExploreBudget(budget / 100.f);
+
+					ImGui::Text("tuned: %u threads, grain %u", man_tbb->getTunedConcurrency(), man_tbb->getTunedGrainSize());
+					ImGui::Text("explored %u of %u frames", man_tbb->getExploredFrames(), man_tbb->getTunedFrames());
+				}
+			}
+
+			if (settings.accelerator == Acc::CPU_BIGNUM) {
+				auto* man_big = dynamic_cast<MandelbrotBignum*>(mandelbrot.get()); // will not fail
+				ImGui::Text("limbs: %d (%d-bit)", man_big->getLimbs(), 64 * man_big->getLimbs());
+				ImGui::ProgressBar(man_big->getProgress());
+			}
 		} else if (settings.accelerator == Acc::GPU_CUDA) {
 			static const char* sizes[] = { "1x1", "2x2", "4x4", "8x8", "16x16" };
 
@@ -243,18 +324,62 @@ void GUI::showAcceleratorUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 			ImGui::Text("block size:");
 			if (ImGui::Combo(IMGUI_NO_LABEL, &block_size, sizes, 5))
 				man_cuda->setBlockSize(pow(block_size + 1, 2));
+		}
 
-			auto sample_total = (int)man_cuda->getTotalSample();
+		if (settings.accelerator != Acc::CPU_BIGNUM) {
+			auto sample_total = (int)mandelbrot->getTotalSample();
 			ImGui::Text("total sample:");
 			if (ImGui::InputInt(IMGUI_NO_LABEL, &sample_total))
-				man_cuda->setTotalSample(sample_total = max(sample_total, 1));
+				mandelbrot->setTotalSample(sample_total = max(sample_total, 1));
 			
-			auto spl = (int)man_cuda->getSamplePerLaunch();
+			auto spl = (int)mandelbrot->getSamplePerLaunch();
 			ImGui::Text("sample per launch:");
 			ImGui::InputInt(IMGUI_NO_LABEL, &spl);
-			man_cuda->setSamplePerLaunch(spl = SDL_clamp(spl, 1, sample_total));
+			mandelbrot->setSamplePerLaunch(spl = SDL_clamp(spl, 1, sample_total));
+
+			static const char* sequences[] = { "random", "R2", "Owen-scrambled Sobol" };
 
-			ImGui::Text("sampled: %d", man_cuda->getSampleCount());
+			auto sequence = mandelbrot->getSampleSequence();
+			ImGui::Text("sample sequence:");
+			if (ImGui::Combo(IMGUI_NO_LABEL, (int*)&sequence, sequences, 3))
+				mandelbrot->setSampleSequence(sequence);
+
+			ImGui::Text("sampled: %d", mandelbrot->getSampleCount());
+		}
+
+		if (settings.accelerator == Acc::CPU || settings.accelerator == Acc::CPU_TBB) {
+			auto adaptive = mandelbrot->getAdaptiveSampling();
+			if (ImGui::Checkbox("adaptive sampling", &adaptive))
+				mandelbrot->setAdaptiveSampling(adaptive);
+
+			if (adaptive) {
+				float tolerance = mandelbrot->getSampleTolerance();
+				ImGui::Text("tolerance (luminance):");
+				if (ImGui::DragFloat(IMGUI_NO_LABEL, &tolerance, .05f, .1f, 32.f, "%.2f", ImGuiSliderFlags_Logarithmic))
+					mandelbrot->setSampleTolerance(tolerance);
+
+				auto budget = (int)mandelbrot->getSampleBudget();
+				ImGui::Text("sample budget per pass:");
+				if (ImGui::InputInt(IMGUI_NO_LABEL, &budget, 4096))
+					mandelbrot->setSampleBudget(max(budget, 1));
+			}
+
+			ImGui::Text("refined: %llu samples", (unsigned long long)mandelbrot->getRefinedSamples());
+
+			auto prefetch = mandelbrot->getPrefetch();
+			if (ImGui::Checkbox("prefetch", &prefetch))
+				mandelbrot->setPrefetch(prefetch);
+
+			if (prefetch) {
+				auto budget = (int)(mandelbrot->getPrefetchBudget() >> 20);
+				ImGui::Text("prefetch budget (MB):");
+				if (ImGui::InputInt(IMGUI_NO_LABEL, &budget, 16))
+					mandelbrot->setPrefetchBudget((size_t)SDL_clamp(budget, 0, 4096) << 20);
+
+				ImGui::Text("cache: %.1f MB\nprefetched: %llu pixels, %llu shown",
+					mandelbrot->getPrefetchBytes() / 1048576., (unsigned long long)mandelbrot->getPrefetchedPixels(),
+					(unsigned long long)mandelbrot->getPrefetchHits());
+			}
 		}
 	}
 }
@@ -279,6 +404,62 @@ void GUI::showAppearanceUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 		ImGui::Text("smooth color :");
 		if (ImGui::Checkbox(IMGUI_NO_LABEL, &smooth))
 			mandelbrot->setColorSmooth(smooth);
+
+		static const char* overlays[] = { "none", "samples per pixel", "tile time", "tile iterations", "tile thread" };
+
+		auto overlay = mandelbrot->getOverlay();
+		ImGui::Text("overlay :");
+		if (ImGui::Combo(IMGUI_NO_LABEL, (int*)&overlay, overlays, 5))
+			mandelbrot->setOverlay(overlay);
+
+		if (overlay >= Mandelbrot::Overlay::TileTime)
+			showTileCosts(mandelbrot);
+	}
+}
+
+// what the tile overlays show in numbers: how evenly the threads were loaded and the tile
+// under the cursor
+void GUI::showTileCosts(std::unique_ptr<Mandelbrot>& mandelbrot)
+{
+	mandelbrot->getTileCosts(plot.tiles);
+	if (plot.tiles.empty()) {
+		ImGui::TextWrapped("no tiles recorded, only the TBB and bignum renderers split the image into tiles");
+		return;
+	}
+
+	double slowest = 0.;
+	for (auto& ms : plot.thread_ms) ms = 0.;
+	for (auto& tile : plot.tiles) {
+		if (tile.thread >= (int)plot.thread_ms.size()) plot.thread_ms.resize(tile.thread + 1, 0.);
+		if (tile.thread >= 0) plot.thread_ms[tile.thread] += tile.ns / 1e6;
+		slowest = max(slowest, tile.ns / 1e6);
+	}
+
+	int    threads = 0;
+	double busiest = 0., busy = 0.;
+	for (auto ms : plot.thread_ms) {
+		threads += ms > 0.;
+		busiest  = max(busiest, ms);
+		busy    += ms;
+	}
+
+	ImGui::Text(
+		"tiles    : %d on %d threads\n"
+		"slowest  : %.3gms\n"
+		"imbalance: %.2f (busiest / mean)",
+		(int)plot.tiles.size(), threads, slowest, threads ? busiest * threads / busy : 0.);
+
+	if (mouseCaptured()) return;
+
+	int px, py;
+	SDL_GetMouseState(&px, &py);
+	for (auto& tile : plot.tiles) {
+		auto& r = tile.rect;
+		if (px < r.x || px >= r.x + r.w || py < r.y || py >= r.y + r.h) continue;
+
+		ImGui::SetTooltip("tile (%d, %d) %dx%d\n%.3gms, %.3g iterations\n%.3g iterations/px\nthread %d",
+			r.x, r.y, r.w, r.h, tile.ns / 1e6, (double)tile.iterations, (double)tile.iterations / (r.w * r.h), tile.thread);
+		break;
 	}
 }
 
@@ -302,6 +483,79 @@ void GUI::showScreenshotUI(std::unique_ptr<Mandelbrot>& mandelbrot)
 				SDL_FreeSurface(surface);
 			}
 		}
+
+		// the saved file renders the same view offline: Tutorial7Headless --view <file>
+		ImGui::SameLine();
+		if (ImGui::Button("save view")) {
+			auto spec = ViewSpec::capture(*mandelbrot);
+			if (!spec.save(settings.capture_dir + getCaptureName(".view")))
+				postErrorMessage("couldn't save view!\ncheck if your directory exists");
+		}
+	}
+}
+
+void GUI::showMetricsUI(std::unique_ptr<Mandelbrot>& mandelbrot)
+{
+	auto* metrics = mandelbrot->getMetrics();
+	if (!metrics) return;
+
+	if (ImGui::CollapsingHeader("metrics")) {
+		// the buffers are members sized for the whole window, so an open panel doesn't allocate either
+		metrics->getFrames(plot.frames);
+		metrics->getUploads(plot.uploads);
+
+		plot.render_ms.clear();
+		plot.giter.clear();
+		for (auto& frame : plot.frames) {
+			plot.render_ms.push_back((float)frame.render_ms);
+			plot.giter.push_back((float)(frame.getIterationsPerSecond() / 1e9));
+		}
+
+		FrameStats last = plot.frames.empty() ? FrameStats() : plot.frames.back();
+
+		ImGui::Text(
+			"render  : %.3gms\n"
+			"p50/95/99: %.3g / %.3g / %.3gms\n"
+			"computed: %llu px\n"
+			"mirrored: %llu px\n"
+			"reused  : %llu px\n"
+			"iter    : %.3g (%.3g G/s)\n"
+			"colorize: %.3gms (est.)\n"
+			"upload  : %.3gms\n"
+			"cancels : %u (last %.3gms)\n"
+			"allocs  : %llu last frame (%llu bytes)\n"
+			"pixel info: %.3g MB",
+			last.render_ms, metrics->getPercentile(.5), metrics->getPercentile(.95), metrics->getPercentile(.99),
+			(unsigned long long)last.pixels_computed, (unsigned long long)last.pixels_mirrored,
+			(unsigned long long)last.pixels_reused, (double)last.iterations, last.getIterationsPerSecond() / 1e9,
+			last.colorize_ms, plot.uploads.empty() ? 0.f : plot.uploads.back(), metrics->getCancelCount(),
+			metrics->getCancelLatency(), (unsigned long long)alloc_frame_count,
+			(unsigned long long)alloc_frame_bytes, mandelbrot->getRenderInfoBytes() / 1e6);
+
+		auto counters = PerfCounters::isEnabled();
+		if (ImGui::Checkbox("hardware counters", &counters))
+			PerfCounters::setEnabled(counters && PerfCounters::available());
+		if (!PerfCounters::isEnabled() && *PerfCounters::getError())
+			ImGui::TextColored(ImColor(255, 0, 0), PerfCounters::getError());
+		else if (PerfCounters::isEnabled() && !last.perf.empty()) {
+			ImGui::Text("IPC %.2f, %.2f Gcycles\nbranch misses %.2f%%\ncache misses  %.2f%%", last.perf.getIPC(),
+				last.perf.cycles / 1e9, last.perf.getBranchMissRate() * 100., last.perf.getCacheMissRate() * 100.);
+		}
+
+		ImGui::PlotLines("render ms", plot.render_ms.data(), (int)plot.render_ms.size(), 0, nullptr, 0.f, FLT_MAX, { 0, 40 });
+		ImGui::PlotLines("Giter/s", plot.giter.data(), (int)plot.giter.size(), 0, nullptr, 0.f, FLT_MAX, { 0, 40 });
+		ImGui::PlotLines("upload ms", plot.uploads.data(), (int)plot.uploads.size(), 0, nullptr, 0.f, FLT_MAX, { 0, 40 });
+
+		// appends to the same file until stopped, one row per finished frame
+		if (!metrics->isRecording()) {
+			if (ImGui::Button("record CSV") && !metrics->startCSV(settings.capture_dir + getCaptureName(".csv")))
+				postErrorMessage("couldn't open the CSV file!\ncheck if your directory exists");
+		} else if (ImGui::Button("stop recording"))
+			metrics->stopCSV();
+
+		ImGui::SameLine();
+		if (ImGui::Button("reset"))
+			metrics->reset();
 	}
 }
 
@@ -2,19 +2,22 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <SDL2/SDL.h>
 
-class Mandelbrot;
+#include "metrics.h"
+#include "mandelbrot.h"
 
 class GUI
 {
+public:
 	enum class Acc {
-		CPU      = 0,
-		CPU_TBB  = 1,
-		GPU_CUDA = 2
+		CPU        = 0,
+		CPU_TBB    = 1,
+		GPU_CUDA   = 2,
+		CPU_BIGNUM = 3
 	};
 
-public:
 	GUI(SDL_Renderer* renderer);
 	~GUI();
 
@@ -32,6 +35,7 @@ public:
 		Acc     accelerator;
 		float   move_speed;
 		float   scroll_scale;
+		float   zoom_seconds; // of the wheel zoom animation, 0 jumps
 		bool    render_async;
 		bool    scaleToCursor;
 		bool    reset_params;
@@ -51,6 +55,8 @@ private:
 	void showAcceleratorUI(std::unique_ptr<Mandelbrot>& mandelbrot);
 	void showAppearanceUI(std::unique_ptr<Mandelbrot>& mandelbrot);
 	void showScreenshotUI(std::unique_ptr<Mandelbrot>& mandelbrot);
+	void showMetricsUI(std::unique_ptr<Mandelbrot>& mandelbrot);
+	void showTileCosts(std::unique_ptr<Mandelbrot>& mandelbrot);
 	void showErrorMessage();
 
 private:
@@ -59,4 +65,19 @@ private:
 
 	std::string message;
 	int         msg_timepoint;
+
+	struct {
+		std::vector<FrameStats> frames;
+		std::vector<float>      uploads;
+		std::vector<float>      render_ms;
+		std::vector<float>      giter;
+
+		std::vector<Mandelbrot::TileCost> tiles;
+		std::vector<double>               thread_ms; // busy time per arena slot
+	} plot;
+
+	uint64_t alloc_seen;
+	uint64_t alloc_seen_bytes;
+	uint64_t alloc_frame_count;
+	uint64_t alloc_frame_bytes;
 };
\ No newline at end of file
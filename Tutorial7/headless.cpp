@@ -0,0 +1,78 @@
+#define SDL_MAIN_HANDLED
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <stb_image_write.h>
+
+#include "view_spec.h"
+
+// renders one view without a window or renderer, for batch jobs and machines without a display:
+//   Tutorial7Headless --view deep.view --size 3840x2160 --samples 16 --output deep.png
+
+using namespace std;
+
+static bool writeImage(const string& path, const SDL_Surface* surface)
+{
+	auto* pixels = (const uint32_t*)surface->pixels;
+	size_t count = (size_t)surface->w * surface->h;
+
+	if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".raw") == 0) {
+		ofstream file(path, ios::binary);
+		file.write((const char*)pixels, count * sizeof(uint32_t));
+		return file.good();
+	}
+
+	vector<uint8_t> rgb(count * 3);
+	for (size_t i = 0; i < count; ++i) {
+		rgb[3 * i + 0] = (pixels[i] >> 16) & 0xff;
+		rgb[3 * i + 1] = (pixels[i] >> 8) & 0xff;
+		rgb[3 * i + 2] = pixels[i] & 0xff;
+	}
+
+	return stbi_write_png(path.c_str(), surface->w, surface->h, 3, rgb.data(), surface->w * 3) != 0;
+}
+
+int main(int argc, char* argv[])
+{
+	ViewSpec spec;
+	spec.output = "mandelbrot.png";
+
+	string error;
+	if (argc == 2 && string(argv[1]) == "--help") {
+		cout << "usage: " << argv[0] << " [options]\n" << ViewSpec::usage;
+		return 0;
+	}
+	if (!spec.parseArgs(argc, argv, error)) {
+		cout << "error: " << error << "\n\n" << ViewSpec::usage;
+		return -1;
+	}
+
+	auto mandelbrot = spec.createHeadless();
+
+	auto start = chrono::steady_clock::now();
+	mandelbrot->render(false);
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+	double seconds = elapsed.count();
+	double pixels  = (double)spec.width * spec.height;
+	double samples = pixels + mandelbrot->getRefinedSamples();
+	double iters   = (double)mandelbrot->getIterationCount();
+
+	cout << "size      : " << spec.width << "x" << spec.height << ", " << samples / pixels << " samples/pixel\n";
+	cout << "precision : " << ViewSpec::getName(mandelbrot->getActivePrecision()) << "\n";
+	cout << "time      : " << seconds * 1000. << " ms\n";
+	cout << "pixels/s  : " << pixels / seconds / 1e6 << " M\n";
+	cout << "samples/s : " << samples / seconds / 1e6 << " M\n";
+	cout << "iter/s    : " << iters / seconds / 1e9 << " G\n";
+
+	if (!writeImage(spec.output, mandelbrot->getSurface())) {
+		cout << "error: couldn't write " << spec.output << "\n";
+		return -1;
+	}
+	cout << "saved     : " << spec.output << "\n";
+
+	return 0;
+}
\ No newline at end of file
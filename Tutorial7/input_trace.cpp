@@ -0,0 +1,287 @@
+#include "input_trace.h"
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+// one line per frame and one per event, plain numbers so a trace can be diffed and edited:
+//   F <frame> <ms> <frame time ms>
+//   E <frame> <ms> <SDL event type> <fields of that type>
+
+bool InputTrace::startRecording(const string& path)
+{
+	file.open(path);
+	if (!file) return false;
+
+	file << "# mandelbrot input trace\n";
+	mode  = Mode::Record;
+	start = chrono::steady_clock::now();
+	return true;
+}
+
+bool InputTrace::load(const string& path, Speed speed, string& error)
+{
+	ifstream in(path);
+	if (!in) {
+		error = "couldn't open " + path;
+		return false;
+	}
+
+	events.clear();
+	frames.clear();
+
+	string line;
+	for (int n = 1; getline(in, line); ++n) {
+		if (line.empty() || line[0] == '#') continue;
+
+		istringstream ss(line);
+		char   kind;
+		Event  event = {};
+		Frame  frame = {};
+		bool   ok    = false;
+
+		if (ss >> kind) {
+			if (kind == 'F') {
+				ok = (bool)(ss >> frame.frame >> frame.time >> frame.frame_time);
+				if (ok) frames.push_back(frame);
+			} else if (kind == 'E') {
+				ok = (ss >> event.frame >> event.time) && read(ss, event.event);
+				if (ok) events.push_back(event);
+			}
+		}
+
+		if (!ok) {
+			error = path + ":" + to_string(n) + ": invalid line \"" + line + "\"";
+			return false;
+		}
+	}
+
+	mode        = Mode::Replay;
+	this->speed = speed;
+	next_event  = 0;
+	start       = chrono::steady_clock::now();
+	return true;
+}
+
+double InputTrace::now() const
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void InputTrace::beginFrame()
+{
+	auto time = now();
+
+	if (frame > 0) {
+		frame_time = time - frame_begin;
+		if (mode == Mode::Replay) frame_times.push_back(frame_time);
+		if (mode == Mode::Record) file << "F " << frame << " " << time << " " << frame_time << "\n";
+	}
+
+	frame_begin = time;
+	++frame;
+}
+
+bool InputTrace::poll(SDL_Event& e)
+{
+	if (mode != Mode::Replay) {
+		if (!SDL_PollEvent(&e)) return false;
+
+		ostringstream fields;
+		if (mode == Mode::Record && write(fields, e))
+			file << "E " << frame << " " << now() << " " << fields.str() << "\n";
+		return true;
+	}
+
+	// the hidden window still gets its own events, only a quit gets through
+	while (SDL_PollEvent(&e))
+		if (e.type == SDL_QUIT) return true;
+
+	if (next_event == events.size()) return false;
+
+	auto& next = events[next_event];
+	bool due   = speed == Speed::Max ? next.frame <= frame : next.time <= now();
+	if (!due) return false;
+
+	e = next.event;
+	++next_event;
+
+	switch (e.type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		keys[e.key.keysym.scancode] = e.key.state;
+		e.key.windowID = SDL_GetWindowID(window);
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		if (e.button.state) mouse_buttons |= SDL_BUTTON(e.button.button);
+		else mouse_buttons &= ~SDL_BUTTON(e.button.button);
+		mouse_x = e.button.x;
+		mouse_y = e.button.y;
+		e.button.windowID = SDL_GetWindowID(window);
+		break;
+	case SDL_MOUSEMOTION:
+		mouse_x = e.motion.x;
+		mouse_y = e.motion.y;
+		e.motion.windowID = SDL_GetWindowID(window);
+		break;
+	case SDL_MOUSEWHEEL:
+		e.wheel.windowID = SDL_GetWindowID(window);
+		break;
+	case SDL_WINDOWEVENT:
+		// the handlers read the size back from the window
+		if (e.window.event == SDL_WINDOWEVENT_RESIZED)
+			SDL_SetWindowSize(window, e.window.data1, e.window.data2);
+		e.window.windowID = SDL_GetWindowID(window);
+		break;
+	}
+	return true;
+}
+
+const Uint8* InputTrace::getKeyboardState() const
+{
+	return mode == Mode::Replay ? keys : SDL_GetKeyboardState(NULL);
+}
+
+uint32_t InputTrace::getMouseState(int* x, int* y) const
+{
+	if (mode != Mode::Replay) return SDL_GetMouseState(x, y);
+
+	if (x) *x = mouse_x;
+	if (y) *y = mouse_y;
+	return mouse_buttons;
+}
+
+double InputTrace::getRecordedFrameTime() const
+{
+	if (mode != Mode::Replay || speed != Speed::Max) return 0.;
+
+	// frames are written in order, the lookup only has to find this one
+	auto it = lower_bound(frames.begin(), frames.end(), frame,
+		[](const Frame& f, uint32_t frame) { return f.frame < frame; });
+	return it != frames.end() && it->frame == frame ? it->frame_time : 0.;
+}
+
+bool InputTrace::finished() const
+{
+	return mode == Mode::Replay && next_event == events.size();
+}
+
+void InputTrace::endFrame(bool view_changed, bool first_pixel, bool complete)
+{
+	if (mode != Mode::Replay) return;
+
+	if (view_changed) {
+		if (pending_first < 0.)    pending_first    = frame_begin;
+		if (pending_complete < 0.) pending_complete = frame_begin;
+	}
+
+	auto time = now();
+	if (pending_first >= 0. && (first_pixel || complete)) {
+		first_pixel_latency.push_back(time - pending_first);
+		pending_first = -1.;
+	}
+	if (pending_complete >= 0. && complete) {
+		complete_latency.push_back(time - pending_complete);
+		pending_complete = -1.;
+	}
+}
+
+static void printStats(const char* name, vector<double> values)
+{
+	if (values.empty()) {
+		printf("%-22s -\n", name);
+		return;
+	}
+
+	sort(values.begin(), values.end());
+	auto at = [&](double p) { return values[min((size_t)(p * values.size()), values.size() - 1)]; };
+
+	double mean = 0.;
+	for (auto v : values) mean += v;
+	mean /= values.size();
+
+	printf("%-22s %6zu %9.2f %9.2f %9.2f %9.2f %9.2f\n", name, values.size(), mean, at(.5), at(.95), at(.99),
+		values.back());
+}
+
+void InputTrace::printReport() const
+{
+	printf("replayed %zu events over %u frames at %s speed\n\n", next_event, frame,
+		speed == Speed::Max ? "max" : "real");
+	printf("%-22s %6s %9s %9s %9s %9s %9s\n", "ms", "count", "mean", "p50", "p95", "p99", "max");
+	printStats("frame time", frame_times);
+	printStats("input to first pixel", first_pixel_latency);
+	printStats("input to complete", complete_latency);
+}
+
+bool InputTrace::write(ostream& os, const SDL_Event& e)
+{
+	switch (e.type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		os << e.type << " " << (int)e.key.state << " " << (int)e.key.repeat << " " << e.key.keysym.scancode << " "
+		   << e.key.keysym.sym << " " << e.key.keysym.mod;
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		os << e.type << " " << (int)e.button.button << " " << (int)e.button.state << " " << (int)e.button.clicks << " "
+		   << e.button.x << " " << e.button.y;
+		break;
+	case SDL_MOUSEMOTION:
+		os << e.type << " " << e.motion.state << " " << e.motion.x << " " << e.motion.y << " " << e.motion.xrel << " "
+		   << e.motion.yrel;
+		break;
+	case SDL_MOUSEWHEEL:
+		os << e.type << " " << e.wheel.x << " " << e.wheel.y << " " << e.wheel.direction;
+		break;
+	case SDL_WINDOWEVENT:
+		if (e.window.event != SDL_WINDOWEVENT_RESIZED) return false;
+		os << e.type << " " << (int)e.window.event << " " << e.window.data1 << " " << e.window.data2;
+		break;
+	default:
+		// text input, focus and the like only matter to the GUI widgets, quitting ends the recording
+		return false;
+	}
+	return true;
+}
+
+bool InputTrace::read(istream& is, SDL_Event& e)
+{
+	int a, b, c;
+
+	e = {};
+	if (!(is >> e.type)) return false;
+
+	switch (e.type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		is >> a >> b >> c >> e.key.keysym.sym >> e.key.keysym.mod;
+		e.key.state           = (Uint8)a;
+		e.key.repeat          = (Uint8)b;
+		e.key.keysym.scancode = (SDL_Scancode)SDL_clamp(c, 0, SDL_NUM_SCANCODES - 1);
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		is >> a >> b >> c >> e.button.x >> e.button.y;
+		e.button.button = (Uint8)a;
+		e.button.state  = (Uint8)b;
+		e.button.clicks = (Uint8)c;
+		break;
+	case SDL_MOUSEMOTION:
+		is >> e.motion.state >> e.motion.x >> e.motion.y >> e.motion.xrel >> e.motion.yrel;
+		break;
+	case SDL_MOUSEWHEEL:
+		is >> e.wheel.x >> e.wheel.y >> e.wheel.direction;
+		break;
+	case SDL_WINDOWEVENT:
+		is >> a >> e.window.data1 >> e.window.data2;
+		e.window.event = (Uint8)a;
+		break;
+	default:
+		return false;
+	}
+	return !is.fail();
+}
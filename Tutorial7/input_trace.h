@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <SDL2/SDL.h>
+
+// records the input the main loop handles and plays it back in place of the real events, so a
+// session of panning and zooming can be repeated as a benchmark:
+//   Tutorial7 --record pan.input
+//   Tutorial7 --replay pan.input --replay-speed max
+// the replay runs in a hidden window and prints frame times and input latencies when it ends.
+class InputTrace
+{
+public:
+	enum class Mode {
+		Off    = 0,
+		Record = 1,
+		Replay = 2
+	};
+
+	// real keeps the recorded timing, max plays one recorded frame per frame with its frame time
+	enum class Speed {
+		Real = 0,
+		Max  = 1
+	};
+
+	bool startRecording(const std::string& path);
+	bool load(const std::string& path, Speed speed, std::string& error);
+
+	inline Mode getMode() const { return mode; }
+	inline Speed getSpeed() const { return speed; }
+
+	// the window replayed events are addressed to
+	inline void setWindow(SDL_Window* window) { this->window = window; }
+
+	void beginFrame();
+
+	// SDL_PollEvent, recording what it returns or returning the replayed events instead
+	bool poll(SDL_Event& e);
+
+	// what the event handlers would otherwise ask SDL for, follows the replayed events
+	const Uint8* getKeyboardState() const;
+	uint32_t getMouseState(int* x, int* y) const;
+
+	// of the recorded frame being replayed at max speed, 0 otherwise
+	double getRecordedFrameTime() const;
+
+	// all events were delivered
+	bool finished() const;
+
+	// called once per frame after presenting: whether this frame's input moved the view, and
+	// whether the screen shows new pixels of it yet or all of them
+	void endFrame(bool view_changed, bool first_pixel, bool complete);
+	void printReport() const;
+
+private:
+	struct Event {
+		uint32_t frame;
+		double   time; // ms since the start of the recording
+		SDL_Event event;
+	};
+
+	struct Frame {
+		uint32_t frame;
+		double   time;
+		double   frame_time; // ms
+	};
+
+	double now() const;
+	static bool write(std::ostream& os, const SDL_Event& e);
+	static bool read(std::istream& is, SDL_Event& e);
+
+	Mode  mode  = Mode::Off;
+	Speed speed = Speed::Real;
+
+	SDL_Window* window = nullptr;
+
+	std::chrono::steady_clock::time_point start;
+	uint32_t frame       = 0;
+	double   frame_begin = 0.;
+	double   frame_time  = 0.;
+
+	std::ofstream file;
+
+	std::vector<Event> events;
+	std::vector<Frame> frames;
+	size_t next_event = 0;
+
+	Uint8    keys[SDL_NUM_SCANCODES] = {};
+	int      mouse_x       = 0;
+	int      mouse_y       = 0;
+	uint32_t mouse_buttons = 0;
+
+	// when the oldest input not shown yet / not fully rendered yet arrived, -1 if there is none
+	double pending_first    = -1.;
+	double pending_complete = -1.;
+
+	std::vector<double> frame_times;
+	std::vector<double> first_pixel_latency;
+	std::vector<double> complete_latency;
+};
@@ -0,0 +1,273 @@
+#define SDL_MAIN_HANDLED
+
+// everything the tutorials include, pulled in up front so their own includes are no-ops inside
+// the namespaces below
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <complex>
+#include <future>
+#include <atomic>
+#include <cmath>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/blocked_range2d.h>
+#include <oneapi/tbb/task.h>
+#include <oneapi/tbb/task_arena.h>
+#include <oneapi/tbb/global_control.h>
+
+#include "mandelbrot_tbb.h"
+
+// renders the same views with the drawSurface() of every tutorial, to put a number on each step
+// of the progression:
+//   Tutorial7Ladder --cores 1,2,4,8
+// the older tutorials only know how to render into a window, they get a hidden one on the dummy
+// video driver with a software renderer.
+
+// one renderer of the ladder, whatever tutorial it comes from
+struct LadderStep
+{
+	virtual ~LadderStep() = default;
+	virtual void setView(double x, double y, double scale, uint32_t iter) = 0;
+	// makes the next render() start from nothing, outside the timed part
+	virtual void invalidate() {}
+	virtual void render() = 0;
+};
+
+namespace tutorial1 {
+#include "../Tutorial1/mandelbrot.cpp"
+
+struct Step : LadderStep
+{
+	Mandelbrot mandelbrot;
+
+	Step(SDL_Renderer* renderer) : mandelbrot(renderer) {}
+	void setView(double x, double y, double scale, uint32_t iter) override { mandelbrot.setView(x, y, scale, iter); }
+	void render() override { mandelbrot.drawSurface(); }
+};
+}
+
+namespace tutorial2 {
+#include "../Tutorial2/mandelbrot.cpp"
+}
+
+namespace tutorial3 {
+#include "../Tutorial3/mandelbrot.cpp"
+}
+
+namespace tutorial4 {
+#include "../Tutorial4/mandelbrot.cpp"
+#include "../Tutorial4/mandelbrot_tbb.cpp"
+}
+
+namespace tutorial5 {
+#include "../Tutorial5/mandelbrot.cpp"
+#include "../Tutorial5/mandelbrot_tbb.cpp"
+}
+
+namespace tutorial6 {
+#include "../Tutorial6/mandelbrot.cpp"
+#include "../Tutorial6/mandelbrot_tbb.cpp"
+}
+
+using namespace std;
+using namespace oneapi;
+
+// Tutorial2 and 3 have the setters, their drawSurface() renders every pixel each time
+template <class T>
+struct SyncStep : LadderStep
+{
+	T mandelbrot;
+
+	SyncStep(SDL_Renderer* renderer) : mandelbrot(renderer) {}
+	void setView(double x, double y, double scale, uint32_t iter) override
+	{
+		mandelbrot.setPosition(x, y);
+		mandelbrot.setScale(scale);
+		mandelbrot.setIteration(iter);
+	}
+	void render() override { mandelbrot.drawSurface(); }
+};
+
+// from Tutorial4 on, render(false) is public and every setter invalidates the image
+template <class T>
+struct AsyncStep : LadderStep
+{
+	T mandelbrot;
+	double x = 0., y = 0.;
+
+	AsyncStep(SDL_Renderer* renderer) : mandelbrot(renderer) {}
+	void setView(double x, double y, double scale, uint32_t iter) override
+	{
+		this->x = x;
+		this->y = y;
+
+		// Tutorial7 on the double path, like every tutorial before it
+		if constexpr (is_base_of_v<::Mandelbrot, T>)
+			mandelbrot.setPrecision(::Mandelbrot::Precision::Double);
+		mandelbrot.setPosition(x, y);
+		mandelbrot.setScale(scale);
+		mandelbrot.setIteration(iter);
+	}
+	void invalidate() override { mandelbrot.setPosition(x, y); } // the same view, no pixel rendered
+	void render() override { mandelbrot.render(false); }
+};
+
+struct LadderEntry
+{
+	const char* name;
+	const char* technique;
+	bool        parallel;
+	unique_ptr<LadderStep> (*create)(SDL_Renderer*);
+};
+
+template <class T>
+static unique_ptr<LadderStep> create(SDL_Renderer* renderer)
+{
+	return make_unique<T>(renderer);
+}
+
+static const LadderEntry ladder[] = {
+	{ "Tutorial1",     "std::complex, one thread",             false, create<tutorial1::Step> },
+	{ "Tutorial2",     "navigation, same core",                false, create<SyncStep<tutorial2::Mandelbrot>> },
+	{ "Tutorial3",     "gui, same core",                       false, create<SyncStep<tutorial3::Mandelbrot>> },
+	{ "Tutorial4",     "scalar loop, async",                   false, create<AsyncStep<tutorial4::Mandelbrot>> },
+	{ "Tutorial4 TBB", "parallel_for",                         true,  create<AsyncStep<tutorial4::MandelbrotTBB>> },
+	{ "Tutorial5",     "incremental render info",              false, create<AsyncStep<tutorial5::Mandelbrot>> },
+	{ "Tutorial5 TBB", "parallel_for",                         true,  create<AsyncStep<tutorial5::MandelbrotTBB>> },
+	{ "Tutorial6",     "colormaps, smooth coloring",           false, create<AsyncStep<tutorial6::Mandelbrot>> },
+	{ "Tutorial6 TBB", "task_arena",                           true,  create<AsyncStep<tutorial6::MandelbrotTBB>> },
+	{ "Tutorial7",     "symmetry, precision modes",            false, create<AsyncStep<::Mandelbrot>> },
+	{ "Tutorial7 TBB", "symmetry, bounded arena",              true,  create<AsyncStep<::MandelbrotTBB>> }
+};
+
+struct LadderView
+{
+	const char* name;
+	double      x, y, scale;
+};
+
+static const LadderView views[] = {
+	{ "home",     -0.5,    0.,     1.2    },
+	{ "seahorse", -0.7453, 0.1127, 6.5e-3 },
+	{ "interior", -0.1,    0.,     0.05   }
+};
+
+static const char* usage =
+	"options:\n"
+	"  --size <w>x<h>    image size, 640x360 by default\n"
+	"  --iter <n>        iteration limit, 1024 by default\n"
+	"  --cores <n,..>    core counts for the parallel steps, 1 and every core by default\n"
+	"  --repeat <n>      timed renders per view, the median is kept, 3 by default\n";
+
+int main(int argc, char* argv[])
+{
+	int width = 640, height = 360, repeat = 3;
+	uint32_t iter = 1024;
+	vector<int> cores = { 1 };
+
+	int hardware = (int)thread::hardware_concurrency();
+	if (hardware > 1) cores.push_back(hardware);
+
+	for (int i = 1; i < argc; ++i) {
+		string key = argv[i];
+		if (key == "--help" || i + 1 == argc) {
+			cout << "usage: " << argv[0] << " [options]\n" << usage;
+			return key == "--help" ? 0 : -1;
+		}
+		istringstream value(argv[++i]);
+
+		char x;
+		bool ok;
+		if (key == "--size")        ok = (value >> width >> x >> height) && x == 'x' && width > 0 && height > 0;
+		else if (key == "--iter")   ok = (value >> iter) && iter > 0;
+		else if (key == "--repeat") ok = (value >> repeat) && repeat > 0;
+		else if (key == "--cores") {
+			cores.clear();
+			for (int n; value >> n; value >> x) cores.push_back(n);
+			ok = !cores.empty() && *min_element(cores.begin(), cores.end()) > 0;
+		} else ok = false;
+
+		if (!ok) {
+			cout << "error: invalid option " << key << "\n\n" << usage;
+			return -1;
+		}
+	}
+
+	SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+		cout << "error: " << SDL_GetError() << "\n";
+		return -1;
+	}
+
+	auto* window   = SDL_CreateWindow("ladder", 0, 0, width, height, SDL_WINDOW_HIDDEN);
+	auto* renderer = window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE) : nullptr;
+	if (!renderer) {
+		cout << "error: " << SDL_GetError() << "\n";
+		return -1;
+	}
+
+	// sum of the median times over the views, per step and core count
+	constexpr int steps = sizeof(ladder) / sizeof(ladder[0]);
+	vector<vector<double>> times(steps, vector<double>(cores.size()));
+
+	for (size_t c = 0; c < cores.size(); ++c) {
+		tbb::global_control limit(tbb::global_control::max_allowed_parallelism, cores[c]);
+
+		for (int s = 0; s < steps; ++s) {
+			// a single threaded step does not care about the core count
+			if (!ladder[s].parallel && c > 0) {
+				times[s][c] = times[s][0];
+				continue;
+			}
+
+			auto step = ladder[s].create(renderer);
+
+			for (auto& view : views) {
+				step->setView(view.x, view.y, view.scale, iter);
+				step->render(); // warmup
+
+				vector<double> runs;
+				for (int run = 0; run < repeat; ++run) {
+					step->invalidate();
+					auto start = chrono::steady_clock::now();
+					step->render();
+					runs.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+				}
+
+				sort(runs.begin(), runs.end());
+				times[s][c] += runs[runs.size() / 2];
+			}
+		}
+	}
+
+	printf("%dx%d, %u iterations, %d views, median of %d renders\n\n", width, height, iter,
+		(int)(sizeof(views) / sizeof(views[0])), repeat);
+
+	printf("%-14s %-27s", "step", "technique");
+	for (auto n : cores) printf(" | %2d cores: %9s %6s %7s", n, "time", "step", "total");
+	printf("\n");
+
+	for (int s = 0; s < steps; ++s) {
+		printf("%-14s %-27s", ladder[s].name, ladder[s].technique);
+		for (size_t c = 0; c < cores.size(); ++c) {
+			// against the previous row and against Tutorial1 at the same core count
+			double step  = times[SDL_max(s - 1, 0)][c] / times[s][c];
+			double total = times[0][c] / times[s][c];
+			printf(" | %17.1fms %5.2fx %6.2fx", times[s][c] * 1e3, step, total);
+		}
+		printf("\n");
+	}
+
+	SDL_DestroyRenderer(renderer);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+
+	return 0;
+}
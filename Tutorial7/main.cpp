@@ -2,9 +2,12 @@
 #define INITIAL_WIDTH  1280
 #define INITIAL_HEIGHT 720
 #define FRAME_LIMIT 60
+#define TRACE_DUMP_SECONDS 10.
+#define RESIZE_SETTLE_SECONDS .2
 
 #include <iostream>
 #include <memory>
+#include <vector>
 #include <SDL2/SDL.h>
 
 #define TIME_IMPL
@@ -12,9 +15,17 @@
 #include "mandelbrot_cuda.h"
 #include "time.h"
 #include "gui.h"
+#include "view_spec.h"
+#include "trace.h"
+#include "input_trace.h"
 
 using namespace std;
 
+static const char* input_usage =
+	"  --record <file>          record the input of this session\n"
+	"  --replay <file>          play a recorded session back in a hidden window and report its latencies\n"
+	"  --replay-speed <s>       real or max, real by default\n";
+
 void Init() {
 	if (SDL_Init(SDL_INIT_VIDEO)) {
 		cout << "error initializing SDL: " << SDL_GetError() << endl;
@@ -26,9 +37,9 @@ void Terminate() {
 	SDL_Quit();
 }
 
-void EventAsync(unique_ptr<GUI>& gui, unique_ptr<Mandelbrot>& mandelbrot) {
+void EventAsync(unique_ptr<GUI>& gui, unique_ptr<Mandelbrot>& mandelbrot, InputTrace& input) {
 	if (gui->keyCaptured()) return;
-	auto* keyStates = SDL_GetKeyboardState(NULL);
+	auto* keyStates = input.getKeyboardState();
 	if (keyStates[SDL_SCANCODE_W] || keyStates[SDL_SCANCODE_UP])
 		mandelbrot->move(0, gui->settings.move_speed * Time::dt);
 	if (keyStates[SDL_SCANCODE_A] || keyStates[SDL_SCANCODE_LEFT])
@@ -39,7 +50,7 @@ void EventAsync(unique_ptr<GUI>& gui, unique_ptr<Mandelbrot>& mandelbrot) {
 		mandelbrot->move(-gui->settings.move_speed * Time::dt, 0);
 }
 
-void KeyProc(SDL_KeyboardEvent& e, unique_ptr<Mandelbrot>& mandelbrot) {
+void KeyProc(SDL_KeyboardEvent& e, unique_ptr<Mandelbrot>& mandelbrot, InputTrace& input) {
 	switch (e.keysym.scancode) {
 	case SDL_SCANCODE_COMMA: {
 		auto iter = mandelbrot->getIteration();
@@ -47,24 +58,37 @@ void KeyProc(SDL_KeyboardEvent& e, unique_ptr<Mandelbrot>& mandelbrot) {
 			mandelbrot->setIteration(iter - 1);
 		break;
 	}
-	case SDL_SCANCODE_PERIOD:
+	case SDL_SCANCODE_PERIOD: {
 		auto iter = mandelbrot->getIteration();
 		mandelbrot->setIteration(iter + 1);
 		break;
 	}
+	case SDL_SCANCODE_N: {
+		int px, py;
+		input.getMouseState(&px, &py);
+		mandelbrot->findNucleus(px, py);
+		break;
+	}
+	}
 }
 
-bool EventProc(unique_ptr<GUI>& gui, unique_ptr<Mandelbrot>& mandelbrot) {
-	static bool mouse_pressed = false;
+bool EventProc(unique_ptr<GUI>& gui, unique_ptr<Mandelbrot>& mandelbrot, InputTrace& input) {
+	static bool   mouse_pressed = false;
+	static double resize_settle = 0.;
 
 	SDL_Event e;
-	while (SDL_PollEvent(&e)) {
+	while (input.poll(e)) {
 		gui->processEvent(&e);
 		switch (e.type) {
 		case SDL_QUIT: return true;
 		case SDL_KEYDOWN:
 			if (gui->keyCaptured()) break;
-			KeyProc(e.key, mandelbrot);
+#ifdef MANDELBROT_TRACE
+			// open in chrome://tracing or ui.perfetto.dev
+			if (e.key.keysym.scancode == SDL_SCANCODE_F9 && !Trace::dump(string(gui->settings.capture_dir) + "trace.json", TRACE_DUMP_SECONDS))
+				gui->postErrorMessage("couldn't save the trace!\ncheck if your directory exists");
+#endif
+			KeyProc(e.key, mandelbrot, input);
 			break;
 		case SDL_MOUSEBUTTONDOWN:
 		case SDL_MOUSEBUTTONUP:
@@ -79,52 +103,122 @@ bool EventProc(unique_ptr<GUI>& gui, unique_ptr<Mandelbrot>& mandelbrot) {
 		case SDL_MOUSEWHEEL:
 			if (gui->mouseCaptured()) break;
 			if (e.wheel.y != 0) {
-				auto scale = mandelbrot->getScale();
+				// notches in quick succession add up to one animation towards their product
+				auto scale = mandelbrot->getTargetScale();
 				if (e.wheel.y > 0) scale *= gui->settings.scroll_scale;
 				else scale /= gui->settings.scroll_scale;
 
+				Mandelbrot::real_t px = mandelbrot->getWidth() / 2., py = mandelbrot->getHeight() / 2.;
 				if (gui->settings.scaleToCursor) {
-					int px, py;
-					SDL_GetMouseState(&px, &py);
-					mandelbrot->setScaleTo(scale, px, py);
-				} else {
-					mandelbrot->setScale(scale);
+					int x, y;
+					input.getMouseState(&x, &y);
+					px = x, py = y;
 				}
+				mandelbrot->animateScaleTo(scale, px, py, gui->settings.zoom_seconds);
 			}
 			break;
 		case SDL_WINDOWEVENT:
-			if (e.window.event == SDL_WINDOWEVENT_RESIZED)
+			// a preview while the size keeps changing, the full resolution once it settles
+			if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
+				mandelbrot->setPreview(true);
 				mandelbrot->resize();
+				resize_settle = RESIZE_SETTLE_SECONDS;
+			}
 		}
 	}
 
-	EventAsync(gui, mandelbrot);
+	if (mandelbrot->getPreview() && (resize_settle -= Time::dt) <= 0.)
+		mandelbrot->setPreview(false);
+
+	EventAsync(gui, mandelbrot, input);
 	return false;
 }
 
 int main(int argc, char* argv[]) {
-	Time::fps_limit = FRAME_LIMIT;
+	// the same options as the headless renderer pick the initial view
+	ViewSpec spec;
+	spec.width  = INITIAL_WIDTH;
+	spec.height = INITIAL_HEIGHT;
+	spec.iter   = 32;
+
+	// the input trace options are taken out, the rest describes the view
+	string record, replay, replay_speed = "real", error;
+	vector<char*> args = { argv[0] };
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if ((arg == "--record" || arg == "--replay" || arg == "--replay-speed") && i + 1 < argc)
+			(arg == "--record" ? record : arg == "--replay" ? replay : replay_speed) = argv[++i];
+		else args.push_back(argv[i]);
+	}
+
+	if (!spec.parseArgs((int)args.size(), args.data(), error)) {
+		cout << "error: " << error << "\n\n" << ViewSpec::usage << input_usage;
+		return -1;
+	}
+	if (replay_speed != "real" && replay_speed != "max") {
+		cout << "error: unknown replay speed \"" << replay_speed << "\"\n\n" << ViewSpec::usage << input_usage;
+		return -1;
+	}
+
+	InputTrace input;
+	auto speed = replay_speed == "max" ? InputTrace::Speed::Max : InputTrace::Speed::Real;
+	if (!replay.empty() && !input.load(replay, speed, error)) {
+		cout << "error: " << error << "\n";
+		return -1;
+	}
+	if (!record.empty() && replay.empty() && !input.startRecording(record)) {
+		cout << "error: couldn't write " << record << "\n";
+		return -1;
+	}
+
+	bool replaying = input.getMode() == InputTrace::Mode::Replay;
+
+	// a replay at max speed is only limited by the rendering, it plays back the recorded frame times
+	Time::fps_limit = replaying && speed == InputTrace::Speed::Max ? 1000000 : FRAME_LIMIT;
 	Init();
 
 	SDL_Window* window = SDL_CreateWindow(
 		"mandelbrot sample",
 		SDL_WINDOWPOS_CENTERED,
 		SDL_WINDOWPOS_CENTERED,
-		INITIAL_WIDTH,
-		INITIAL_HEIGHT,
-		SDL_WINDOW_RESIZABLE);
+		spec.width,
+		spec.height,
+		SDL_WINDOW_RESIZABLE | (replaying ? SDL_WINDOW_HIDDEN : 0));
 	SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+	input.setWindow(window);
+
+	// declared first, the renderers report to it until they are destroyed
+	FrameMetrics metrics;
 
 	unique_ptr<Mandelbrot> mandelbrot = make_unique<MandelbrotCUDA>(renderer);
 	unique_ptr<GUI>        gui        = make_unique<GUI>(renderer);
 
+	spec.apply(*mandelbrot);
+	mandelbrot->setMetrics(&metrics);
+	mandelbrot->setPrefetch(true); // used once the CPU backends are picked
+	if (args.size() > 1) gui->settings.auto_iter = false; // keep the iteration limit the view asked for
+
 	bool closed = false;
 	while (!closed) {
-		closed = EventProc(gui, mandelbrot);
+		TRACE_SCOPE("main loop");
+		input.beginFrame();
 
-		mandelbrot->render(gui->settings.render_async); // async
-		gui->update(mandelbrot);
-		gui->render();
+		auto pos_x = mandelbrot->getPositionX(), pos_y = mandelbrot->getPositionY();
+		auto scale = mandelbrot->getScale();
+		auto iter  = mandelbrot->getIteration();
+		{
+			TRACE_SCOPE("events");
+			closed = EventProc(gui, mandelbrot, input);
+		}
+		{
+			TRACE_SCOPE("render");
+			mandelbrot->render(gui->settings.render_async, Time::dt); // async
+		}
+		{
+			TRACE_SCOPE("imgui");
+			gui->update(mandelbrot);
+			gui->render();
+		}
 
 		if (gui->settings.reset_params) {
 			mandelbrot->setPosition(0., 0.);
@@ -133,13 +227,36 @@ int main(int argc, char* argv[]) {
 			gui->settings.reset_params = false;
 		}
 
+		// what the texture upload in draw() is going to show
+		bool shows_pixels = mandelbrot->getIterationCount() > 0;
+		bool complete     = !mandelbrot->isRendering();
+
 		mandelbrot->draw();
-		gui->draw();
-		SDL_RenderPresent(renderer);
+		{
+			TRACE_SCOPE("gui draw");
+			gui->draw();
+		}
+		{
+			TRACE_SCOPE("present");
+			SDL_RenderPresent(renderer);
+		}
+		{
+			TRACE_SCOPE("frame limit");
+			Time::update();
+			if (auto frame_time = input.getRecordedFrameTime()) Time::dt = frame_time / 1e3;
+		}
 
-		Time::update();
+		if (replaying) {
+			bool changed = !(mandelbrot->getPositionX() == pos_x) || !(mandelbrot->getPositionY() == pos_y) ||
+				mandelbrot->getScale() != scale || mandelbrot->getIteration() != iter;
+
+			input.endFrame(changed, shows_pixels, complete);
+			closed |= input.finished() && complete;
+		}
 	}
 
+	if (replaying) input.printReport();
+
 	mandelbrot.reset();
 
 	SDL_DestroyWindow(window);
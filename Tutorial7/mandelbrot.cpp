@@ -1,9 +1,23 @@
 #include "mandelbrot.h"
 
+#include <cfloat>
+#include <algorithm>
+#include <chrono>
 #include <tbb/parallel_for.h>
-#include <oneapi/tbb/blocked_range2d.h>
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/task_arena.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 #include "color.h"
+#include "reproject.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -15,57 +29,53 @@ static bool in_range(const T& x, const T& min, const T& max)
 	return min <= x && x <= max;
 }
 
-static void blitScaled(SDL_Surface* src, const SDL_Rect* srcrect, SDL_Surface* dst, SDL_Rect* dstrect) 
-{
-	using range_t = tbb::blocked_range2d<int, int>;
-
-	SDL_Rect src_rect = { 0, 0, src->w, src->h };
-	SDL_Rect dst_rect = { 0, 0, dst->w, dst->h };
-
-	if (srcrect) src_rect = *srcrect;
-	if (dstrect) dst_rect = *dstrect;
+// below this many samples the variance estimate is unreliable, so neighbour contrast decides
+static constexpr uint32_t adaptive_min_samples = 4;
 
-	auto get_pixel = [](SDL_Surface * surface, int x, int y) {
-		if (x < 0 || surface->w <= x || y < 0 || surface->h <= y)
-			return SDL_Color{};
-		return ((SDL_Color*)surface->pixels)[surface->w * y + x];
-	};
+static float luminance(uint32_t color)
+{
+	return (2 * ((color >> 16) & 0xff) + 5 * ((color >> 8) & 0xff) + (color & 0xff)) / 8.f;
+}
 
-	auto map = [rx = (float)src_rect.w / dst_rect.w, ry = (float)src_rect.h / dst_rect.h, dst_rect, src_rect](int x, int y) {
-		return SDL_Point{
-			(int)roundf(rx * (x - dst_rect.x) + src_rect.x),
-			(int)roundf(ry * (y - dst_rect.y) + src_rect.y)
-		};
-	};
+// a surface over the first width * height values of pixels, it doesn't own them
+static SDL_Surface* createSurface(Mandelbrot::Plane<uint32_t>& pixels, int width, int height)
+{
+	return SDL_CreateRGBSurfaceFrom(pixels.data, width, height, 32, width * 4, 0, 0, 0, 0);
+}
 
-	range_t range(0, dst->h, 0, dst->w);
-	tbb::parallel_for(range, [=](const range_t& r) {
-		for (int h = r.rows().begin(); h < r.rows().end(); ++h) {
-			for (int w = r.cols().begin(); w < r.cols().end(); ++w) {
-				if (!in_range(w, dst_rect.x, dst_rect.x + dst_rect.w) ||
-					!in_range(h, dst_rect.y, dst_rect.y + dst_rect.h)) {
-					((SDL_Color*)dst->pixels)[dst->w * h + w] = SDL_Color{};
-				} else {
-					auto point = map(w, h);
-					((SDL_Color*)dst->pixels)[dst->w * h + w] = get_pixel(src, point.x, point.y);
-				}
-			}
-		}
-	});
+static SDL_Point getWindowSize(SDL_Renderer* renderer)
+{
+	SDL_Point size;
+	SDL_GetWindowSize(SDL_RenderGetWindow(renderer), &size.x, &size.y);
+	return size;
 }
 
 Mandelbrot::Mandelbrot(SDL_Renderer* renderer)
-	: renderer(renderer)
+	: Mandelbrot(getWindowSize(renderer).x, getWindowSize(renderer).y)
+{
+	this->renderer = renderer;
+	window         = SDL_RenderGetWindow(renderer);
+	texture_width  = width;
+	texture_height = height;
+	texture        = SDL_CreateTexture(renderer, surface->format->format, SDL_TEXTUREACCESS_STREAMING, width, height);
+}
+
+Mandelbrot::Mandelbrot(int width, int height)
+	: window(nullptr), renderer(nullptr), texture(nullptr), width(width), height(height)
 {
-	window = SDL_RenderGetWindow(renderer);
-	
-	SDL_GetWindowSize(window, &width, &height);
 	aspect = (real_t)width / height;
 
 	render_info.resize(width, height);
-	surface_temp = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
-	surface      = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
-	texture      = SDL_CreateTextureFromSurface(renderer, surface);
+	pixels.allocate((size_t)width * height);
+	pixels_temp.allocate((size_t)width * height);
+	pixels_overlay.allocate((size_t)width * height);
+	surface_temp = createSurface(pixels_temp, width, height);
+	surface      = createSurface(pixels, width, height);
+
+	surface_overlay = createSurface(pixels_overlay, width, height);
+	texture_width   = 0;
+	texture_height  = 0;
+	preview         = false;
 
 	pos_x = 0.;
 	pos_y = 0.;
@@ -76,6 +86,49 @@ Mandelbrot::Mandelbrot(SDL_Renderer* renderer)
 	color_scale = 4;
 	smooth      = true;
 
+	precision = Precision::Auto;
+
+	sample_total      = 1;
+	sample_per_launch = 1;
+	sample_count      = 0;
+	sample_sequence   = sampling::Sequence::Sobol;
+	sample_seed       = 0;
+
+	adaptive         = false;
+	sample_tolerance = 1.;
+	sample_budget    = 1 << 17;
+	refined_samples  = 0;
+	iteration_count  = 0;
+
+	overlay = Overlay::None;
+
+	tiles_next.resize(max_tile_costs);
+	tiles_last.resize(max_tile_costs);
+	tiles_next_count = 0;
+	tiles_last_count = 0;
+
+	metrics         = nullptr;
+	pixels_computed = 0;
+	pixels_mirrored = 0;
+	colorize_ns     = 0;
+
+	snap_pending = false;
+
+	prefetch          = false;
+	prefetch_budget   = 64 << 20;
+	prefetch_planned  = false;
+	prefetch_pending  = false;
+	prefetching       = false;
+	prefetch_clock    = 0;
+	prefetch_rendered = 0;
+	prefetch_hits     = 0;
+	pan_next          = 0;
+	prefetch_tiles.resize(max_prefetch_tiles);
+	prefetch_queue.reserve(max_prefetch_tiles);
+
+	worker_pending = false;
+	worker_quit    = false;
+
 	is_rendering = false;
 	stop_all     = false;
 	updated      = false;
@@ -84,71 +137,205 @@ Mandelbrot::Mandelbrot(SDL_Renderer* renderer)
 Mandelbrot::~Mandelbrot()
 {
 	stop();
+
+	if (worker.joinable()) {
+		{
+			lock_guard<mutex> guard(worker_lock);
+			worker_quit = true;
+		}
+		worker_signal.notify_all();
+		worker.join();
+	}
+
 	render_info.destroy();
+	freePrefetch();
 	SDL_FreeSurface(surface_temp);
 	SDL_FreeSurface(surface);
-	SDL_DestroyTexture(texture);
+	SDL_FreeSurface(surface_overlay);
+	pixels.free();
+	pixels_temp.free();
+	pixels_overlay.free();
+	if (texture) SDL_DestroyTexture(texture);
 }
 
-void Mandelbrot::render(bool async)
+void Mandelbrot::render(bool async, double frame_seconds)
 {
+	if (snap_pending && !nucleus_finder.isRunning()) {
+		snap_pending = false;
+		snapToNucleus();
+	}
+
+	if (zoom.active) {
+		advanceAnimation(frame_seconds);
+		if (zoom.active) return;
+	}
+
 	if (!updated) {
 		if (!async) {
 			is_rendering = true; // just in case...
-			drawSurface();
+			renderFrame();
 			is_rendering = false;
-		} else 
+		} else {
+			is_rendering = true; // before the task starts, so stop() and isRendering() see it right away
 			startAsync();
+		}
 
 		updated = true;
+	} else if (!prefetch_planned && !is_rendering) {
+		prefetch_planned = true;
+		if (usesPrefetch()) startPrefetch();
 	}
 }
 
 void Mandelbrot::draw()
 {
-	SDL_UpdateTexture(texture, NULL, surface->pixels, surface->pitch);
-	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+	if (!renderer) return;
+	TRACE_SCOPE("draw");
+
+	auto start = chrono::steady_clock::now();
+
+	auto* source = surface;
+	if (overlay != Overlay::None) {
+		drawOverlay();
+		source = surface_overlay;
+	}
+
+	SDL_Rect rect = { 0, 0, width, height };
+	{
+		TRACE_SCOPE("upload");
+		SDL_UpdateTexture(texture, &rect, source->pixels, source->pitch);
+	}
+
+	if (metrics) metrics->addUpload(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+
+	SDL_RenderCopy(renderer, texture, &rect, nullptr);
 }
 
 void Mandelbrot::stop()
 {
 	if (is_rendering) {
+		TRACE_SCOPE("stop");
+		auto start = chrono::steady_clock::now();
+
 		stop_all = true;
 		wait();
 		stop_all = false;
 		is_rendering = false;
+
+		if (metrics) metrics->addCancel(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
 	}
+
+	stopPrefetch();
 }
 
 void Mandelbrot::wait()
 {
-	if (is_rendering)
-		future.get(); // or wait()
+	unique_lock<mutex> guard(worker_lock);
+	worker_signal.wait(guard, [this] { return !worker_pending && !is_rendering; });
 }
 
 bool Mandelbrot::isRendering() const
 {
-	return is_rendering;
+	return is_rendering || zoom.active;
 }
 
 void Mandelbrot::resize()
 {
+	int width, height;
+	SDL_GetWindowSize(window, &width, &height);
+	resize(width, height);
+}
+
+void Mandelbrot::resize(int width, int height)
+{
+	finishAnimation();
 	stop();
-	SDL_FreeSurface(surface);
-	SDL_DestroyTexture(texture);
+	if (width == this->width && height == this->height) return;
+	TRACE_SCOPE("resize");
 
-	SDL_GetWindowSize(window, &width, &height);
-	aspect = (real_t)width / height;
+	// the old image lands at (ox, oy) of the new one, the view follows it to keep every pixel
+	// it had on the same point
+	auto   view = getViewport();
+	int    ox   = (width - this->width) / 2;
+	int    oy   = (height - this->height) / 2;
+	size_t size = (size_t)width * height;
 
-	render_info.resize(width, height);
-	surface_temp = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
-	surface      = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
-	texture      = SDL_CreateTextureFromSurface(renderer, surface);
-	update();
+	pixels_temp.resize(size);
+	SDL_FreeSurface(surface_temp);
+	surface_temp = createSurface(pixels_temp, width, height);
+
+	SDL_Rect rect = { ox, oy, this->width, this->height };
+	SDL_FillRect(surface_temp, nullptr, 0x00000000);
+	SDL_BlitSurface(surface, nullptr, surface_temp, &rect);
+	swapSurfaces();
+
+	pixels_temp.resize(size);
+	SDL_FreeSurface(surface_temp);
+	surface_temp = createSurface(pixels_temp, width, height);
+
+	pixels_overlay.resize(size);
+	SDL_FreeSurface(surface_overlay);
+	surface_overlay = createSurface(pixels_overlay, width, height);
+
+	render_info.resize(width, height, ox, oy);
+
+	this->width  = width;
+	this->height = height;
+	aspect       = (real_t)width / height;
+	scale        = view.dy * height / 4.;
+	pos_x        = view.min_x + pos_t(view.dx * (width / 2. - ox));
+	pos_y        = view.max_y - pos_t(view.dy * (height / 2. - oy));
+
+	{
+		lock_guard<mutex> guard(tiles_lock);
+		tiles_last_count = 0;
+	}
+
+	if (renderer && (width > texture_width || height > texture_height)) {
+		SDL_RendererInfo info;
+		SDL_GetRendererInfo(renderer, &info);
+
+		texture_width  = SDL_max(texture_width, width + width / 4);
+		texture_height = SDL_max(texture_height, height + height / 4);
+		if (info.max_texture_width)  texture_width  = SDL_min(texture_width, info.max_texture_width);
+		if (info.max_texture_height) texture_height = SDL_min(texture_height, info.max_texture_height);
+
+		SDL_DestroyTexture(texture);
+		texture = SDL_CreateTexture(renderer, surface->format->format, SDL_TEXTUREACCESS_STREAMING, texture_width, texture_height);
+	}
+	update(false, false);
+}
+
+void Mandelbrot::swapSurfaces()
+{
+	std::swap(surface, surface_temp);
+	std::swap(pixels, pixels_temp);
+}
+
+void Mandelbrot::reprojectFrom(const Viewport& from, const SDL_Surface* image, SDL_Surface* target)
+{
+	auto to = getViewport();
+
+	Reprojection r;
+	r.scale_x  = to.dx / from.dx;
+	r.scale_y  = to.dy / from.dy;
+	r.offset_x = (real_t)(to.min_x - from.min_x) / from.dx;
+	r.offset_y = (real_t)(from.max_y - to.max_y) / from.dy;
+
+	reproject(image, target, r);
+}
+
+void Mandelbrot::setPreview(bool preview)
+{
+	if (preview == this->preview) return;
+	stop();
+	this->preview = preview;
+	update(false, false);
 }
 
-void Mandelbrot::setPosition(real_t x, real_t y)
+void Mandelbrot::setPosition(pos_t x, pos_t y)
 {
+	finishAnimation();
 	stop();
 	pos_x   = x;
 	pos_y   = y;
@@ -157,6 +344,8 @@ void Mandelbrot::setPosition(real_t x, real_t y)
 
 void Mandelbrot::move(int32_t rel_px, int32_t rel_py)
 {
+	TRACE_SCOPE("move");
+	finishAnimation();
 	stop();
 	SDL_Rect rect1, rect2;
 	SDL_Rect rect = { rel_px, rel_py, width + rel_px, height + rel_px };
@@ -176,6 +365,9 @@ void Mandelbrot::move(int32_t rel_px, int32_t rel_py)
 		rect2 = { width + rel_px, 0, -rel_px, height + rel_py };
 	}
 
+	pan_steps[pan_next++ % pan_history] = { chrono::steady_clock::now(), rel_px, rel_py };
+	zoom_step = {}; // a drag after a wheel step, the next frames are the pan's to prefetch
+
 	render_info.move(rel_px, rel_py);
 	render_info.fillRect(&rect1);
 	render_info.fillRect(&rect2);
@@ -185,51 +377,128 @@ void Mandelbrot::move(int32_t rel_px, int32_t rel_py)
 	real_t dx = 4. * scale * aspect / width;
 	real_t dy = 4. * scale / height;
 
-	pos_x  -= dx * rel_px;
-	pos_y  += dy * rel_py;
+	pos_x  -= pos_t(dx * rel_px);
+	pos_y  += pos_t(dy * rel_py);
 	update(false, false);
 }
 
 void Mandelbrot::setScale(real_t scale) 
 {
+	TRACE_SCOPE("setScale");
+	finishAnimation();
 	stop();
-	auto mag = this->scale / scale;
-	int w    = width * (1. - mag);
-	int h    = height * (1. - mag);
-
-	SDL_Rect rect = { w / 2, h / 2, width - w, height - h };
-
-	SDL_FillRect(surface_temp, nullptr, 0x00000000);
-	SDL_BlitScaled(surface, nullptr, surface_temp, &rect);
-	std::swap(surface, surface_temp);
-
+	auto from   = getViewport();
 	this->scale = scale;
+
+	reprojectFrom(from, surface, surface_temp);
+	swapSurfaces();
 	update(true, false);
 }
 
 void Mandelbrot::setScaleTo(real_t scale, real_t px, real_t py)
 {
+	TRACE_SCOPE("setScaleTo");
+	finishAnimation();
 	//stop();
-	auto point  = pixelToComplex(px, py);
-	auto mag    = this->scale / scale;
-	int w       = width * (1. - mag);
-	int h       = height * (1. - mag);
+	pos_t point_x, point_y;
+	pixelToComplex(px, py, point_x, point_y);
+	zoom_step = { px, py, scale / this->scale };
 
-	SDL_Rect rect = { w * (px / width), h * (py / height), width - w, height - h};
+	auto from = getViewport();
+	placeScale(scale, point_x, point_y, px, py);
 
-	//SDL_FillRect(surface_temp, nullptr, 0x00000000);
-	//SDL_BlitScaled(surface, nullptr, surface_temp, &rect);
-	blitScaled(surface, nullptr, surface_temp, &rect);
-	std::swap(surface, surface_temp);
+	reprojectFrom(from, surface, surface_temp);
+	swapSurfaces();
+	update(true, false);
+}
+
+void Mandelbrot::animateScaleTo(real_t scale, real_t px, real_t py, double seconds)
+{
+	if (seconds <= 0.) return setScaleTo(scale, px, py);
+	zoom_step = { px, py, scale / getTargetScale() };
+
+	if (!zoom.active) {
+		stop();
+		zoom.active = true;
+		zoom.source = getViewport();
+		swapSurfaces();
+	}
+
+	pixelToComplex(px, py, zoom.x, zoom.y);
+	zoom.px         = px;
+	zoom.py         = py;
+	zoom.from_scale = this->scale;
+	zoom.to_scale   = scale;
+	zoom.seconds    = seconds;
+	zoom.elapsed    = 0.;
+}
+
+// eased out, and even in log scale so every frame zooms by about the same factor
+void Mandelbrot::advanceAnimation(double frame_seconds)
+{
+	TRACE_SCOPE("zoom frame");
+	zoom.elapsed += frame_seconds;
+	double t      = zoom.elapsed / zoom.seconds;
+
+	if (t >= 1.) {
+		finishAnimation();
+		update(true, false);
+		return;
+	}
+
+	double ease = 1. - (1. - t) * (1. - t) * (1. - t);
+	placeScale(zoom.from_scale * pow(zoom.to_scale / zoom.from_scale, ease), zoom.x, zoom.y, zoom.px, zoom.py);
+	reprojectFrom(zoom.source, surface_temp, surface);
+}
+
+void Mandelbrot::finishAnimation()
+{
+	if (!zoom.active) return;
+	zoom.active = false;
+
+	placeScale(zoom.to_scale, zoom.x, zoom.y, zoom.px, zoom.py);
+	reprojectFrom(zoom.source, surface_temp, surface);
+	render_info.reset();
+}
 
+void Mandelbrot::placeScale(real_t scale, const pos_t& x, const pos_t& y, real_t px, real_t py)
+{
+	getScaledCenter(scale, x, y, px, py, pos_x, pos_y);
 	this->scale = scale;
+}
 
+void Mandelbrot::getScaledCenter(real_t scale, const pos_t& x, const pos_t& y, real_t px, real_t py, pos_t& cx, pos_t& cy) const
+{
 	real_t dx = 4. * scale * aspect / width;
 	real_t dy = 4. * scale / height;
 
-	pos_x   = point.real() + 2. * scale * aspect - px * dx;
-	pos_y   = point.imag() - 2. * scale + py * dy;
-	update(true, false);
+	cx = x + pos_t(2. * scale * aspect - px * dx);
+	cy = y - pos_t(2. * scale - py * dy);
+}
+
+Mandelbrot::Viewport Mandelbrot::getScaledViewport(real_t scale, real_t px, real_t py) const
+{
+	pos_t point_x, point_y, cx, cy;
+	pixelToComplex(px, py, point_x, point_y);
+	getScaledCenter(scale, point_x, point_y, px, py, cx, cy);
+	return getViewport(scale, cx, cy);
+}
+
+void Mandelbrot::findNucleus(real_t px, real_t py)
+{
+	pos_t cx, cy;
+	pixelToComplex(px, py, cx, cy);
+
+	// the period can not exceed what the current iteration limit resolves
+	nucleus_finder.start(cx, cy, 2. * scale, iter);
+	snap_pending = true;
+}
+
+void Mandelbrot::snapToNucleus()
+{
+	NucleusFinder::Candidate nucleus;
+	if (nucleus_finder.getNearest(nucleus))
+		setPosition(nucleus.x, nucleus.y);
 }
 
 void Mandelbrot::setIteration(uint32_t iter)
@@ -257,123 +526,1300 @@ void Mandelbrot::setColorSmooth(bool val)
 	update(true, false);
 }
 
+void Mandelbrot::setPrecision(Precision precision)
+{
+	this->precision = precision;
+	update(true, false);
+}
+
+void Mandelbrot::setTotalSample(uint32_t sample)
+{
+	auto clear = sample_count > (sample_total = sample);
+	update(clear, clear);
+}
+
+void Mandelbrot::setSampleSequence(sampling::Sequence sequence)
+{
+	sample_sequence = sequence;
+	update(true, false);
+}
+
+void Mandelbrot::setSampleSeed(uint32_t seed)
+{
+	sample_seed = seed;
+	update(true, false);
+}
+
+// samples stay valid either way, pixels keep their counts and the next render refines from there
+void Mandelbrot::setAdaptiveSampling(bool val)
+{
+	adaptive = val;
+	update(false, false);
+}
+
+// a tighter tolerance queues more pixels in the next adaptive pass, a looser one fewer
+void Mandelbrot::setSampleTolerance(real_t tolerance)
+{
+	sample_tolerance = tolerance;
+	update(false, false);
+}
+
+// neither needs the frame to start over, only the next plan to come
+void Mandelbrot::setPrefetch(bool val)
+{
+	stopPrefetch();
+	prefetch         = val;
+	prefetch_planned = false;
+	if (!val) freePrefetch();
+}
+
+void Mandelbrot::setPrefetchBudget(size_t bytes)
+{
+	stopPrefetch();
+	prefetch_budget  = bytes;
+	prefetch_planned = false;
+
+	prefetch_queue.clear();
+	while (getPrefetchBytes() > prefetch_budget)
+		evictPrefetch(max_prefetch_tiles);
+}
+
+size_t Mandelbrot::getPrefetchBytes() const
+{
+	size_t bytes = 0;
+	for (auto& tile : prefetch_tiles) bytes += tile.pixels.getBytes();
+	return bytes;
+}
+
+Mandelbrot::Precision Mandelbrot::getActivePrecision() const
+{
+	return getActivePrecision(scale, pos_x, pos_y);
+}
+
+Mandelbrot::Precision Mandelbrot::getActivePrecision(real_t scale, const pos_t& pos_x, const pos_t& pos_y) const
+{
+	real_t dy = 4. * scale / height;
+
+	if (precision == Precision::Fixed) {
+		// 4 integer bits, the pixel size and 16 guard bits for error growth along the orbit
+		auto bits = 4 - (int)log2(dy) + 16;
+		if (bits <= 128) return Precision::Fixed128;
+		if (bits <= 192) return Precision::Fixed192;
+		return Precision::Fixed256;
+	}
+
+	if (precision != Precision::Auto) return precision;
+
+	// switch over while a pixel is still ~1000 ulps wide, so rounding in the orbit stays invisible
+	real_t mag = SDL_max(1., SDL_max(fabs((real_t)pos_x), fabs((real_t)pos_y)));
+	return dy < 1024. * DBL_EPSILON * mag ? Precision::DoubleDouble : Precision::Double;
+}
+
 std::complex<real_t> Mandelbrot::pixelToComplex(real_t px, real_t py) const
 {
-	real_t min_x = pos_x - 2. * scale * aspect;
-	real_t max_y = pos_y + 2. * scale;
-	real_t dx    = 4. * scale * aspect / width;
+	pos_t cx, cy;
+	pixelToComplex(px, py, cx, cy);
+	return { (real_t)cx, (real_t)cy };
+}
+
+void Mandelbrot::pixelToComplex(real_t px, real_t py, pos_t& cx, pos_t& cy) const
+{
+	real_t dx = 4. * scale * aspect / width;
+	real_t dy = 4. * scale / height;
+
+	cx = pos_x + pos_t(px * dx - 2. * scale * aspect);
+	cy = getMaxY(scale, pos_y) - pos_t(py * dy);
+}
+
+// pans move by whole pixels, so past this many rows from the axis they would take a million
+// frames to bring it on screen. the rounding would also start to cost precision out there.
+static constexpr real_t axis_snap_rows = 1 << 20;
+
+Mandelbrot::pos_t Mandelbrot::getMaxY(real_t scale, const pos_t& pos_y) const
+{
+	pos_t  max_y = pos_y + pos_t(2. * scale);
 	real_t dy    = 4. * scale / height;
-	return { min_x + px * dx, max_y - py * dy };
+
+	// rows h and h' sample mirror images when h + h' = axis, see getMirror()
+	real_t axis = 2. * (real_t)max_y / dy - 1.;
+	if (fabs(axis) > axis_snap_rows) return max_y;
+
+	return pos_t(dy * (round(axis) + 1.) / 2.);
 }
 
 void Mandelbrot::startAsync()
 {
-	future = async(launch::async, [this] {
-		is_rendering = true;
-		drawSurface();
+	if (!worker.joinable())
+		worker = thread(&Mandelbrot::workerLoop, this);
+
+	{
+		lock_guard<mutex> guard(worker_lock);
+		worker_pending = true;
+	}
+	worker_signal.notify_all();
+}
+
+void Mandelbrot::workerLoop()
+{
+	unique_lock<mutex> guard(worker_lock);
+	for (;;) {
+		worker_signal.wait(guard, [this] { return worker_pending || prefetch_pending || worker_quit; });
+		if (worker_quit) return;
+
+		// frames go first, the prefetch only runs while there is none
+		if (!worker_pending) {
+			prefetch_pending = false;
+			prefetching      = true;
+			guard.unlock();
+
+			runPrefetch();
+
+			guard.lock();
+			prefetching = false;
+			worker_signal.notify_all();
+			continue;
+		}
+
+		worker_pending = false;
+		is_rendering   = true;
+		guard.unlock();
+
+		renderFrame();
+
+		guard.lock();
 		is_rendering = false;
-	});
+		worker_signal.notify_all();
+	}
+}
+
+void Mandelbrot::renderFrame()
+{
+	TRACE_SCOPE("frame");
+	auto start      = chrono::steady_clock::now();
+	auto iterations = iteration_count.load();
+
+	pixels_computed = 0;
+	pixels_mirrored = 0;
+	colorize_ns     = 0;
+	perf_total.reset();
+	tiles_next_count = 0;
+
+	if (preview) drawPreview();
+	else drawSurface();
+
+	if (stop_all) return;
+
+	{
+		lock_guard<mutex> guard(tiles_lock);
+		swap(tiles_next, tiles_last);
+		tiles_last_count = min<uint32_t>(tiles_next_count, max_tile_costs);
+	}
+
+	if (!metrics) return;
+
+	FrameStats frame;
+	frame.render_ms       = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	frame.colorize_ms     = colorize_ns * colorize_sample_rows / 1e6;
+	frame.pixels_computed = pixels_computed;
+	frame.pixels_mirrored = pixels_mirrored;
+	frame.pixels_reused   = (uint64_t)max<int64_t>((int64_t)width * height - pixels_computed - pixels_mirrored, 0);
+	frame.iterations      = iteration_count - iterations;
+	frame.perf            = perf_total.load();
+
+	metrics->addFrame(frame);
 }
 
 void Mandelbrot::drawSurface()
 {
-	real_t min_x = pos_x - 2. * scale * aspect;
-	real_t max_y = pos_y + 2. * scale;
-	real_t dx    = 4. * scale * aspect / width;
-	real_t dy    = 4. * scale / height;
+	PerfCounters::Scope counters(perf_total);
 
-	for (int h = 0; h < height; ++h) {
-		if (stop_all) return;
+	auto view     = getViewport();
+	auto mirror   = getMirror();
+	auto total    = sample_total;
+	auto per_pass = sample_per_launch;
 
-		for (int w = 0; w < width; ++w) {
-			auto& info = render_info.at(w, h);
-			if (info.rendered) continue;
-
-			uint32_t& pixel = *((uint32_t*)surface->pixels + h * surface->w + w);
-
-			real_t cx = min_x + dx * (w + 0.5f);
-			real_t cy = max_y - dy * (h + 0.5f);
-
-			auto iterated = mandelbrot<real_t>(cx, cy, iter);
-
-			if (iterated == iter) {
-				pixel = 0xff000000;
-			} else if (!smooth) {
-				pixel = colormap[color_idx][(int)(color_scale * 256 * iterated / iter) % 256];
-			} else {
-				double log_zn  = log(cx * cx + cy * cy) / 2.;
-				double nu      = log(log_zn / log(2)) / log(2);
-				auto real_iter = iterated + 3.5 - nu;
-						
-				auto col1 = colormap[color_idx][(int)(color_scale * 256 * real_iter / iter) % 256];
-				auto col2 = colormap[color_idx][(int)(color_scale * 256 * (real_iter + 1) / iter) % 256];
-						
-				pixel = lerp_color(col1, col2, fmod(iter, 1));
-			}
+	auto mirror_band = [&] {
+		for (int h = mirror.begin; h < mirror.end; ++h) {
+			if (stop_all) return false;
+			mirrorRow(h, mirror);
+		}
+		return true;
+	};
+
+	// renders every row the mirror does not cover, then copies the mirrored ones
+	auto pass = [&](auto&& span) {
+		for (int h = 0; h < height; ++h) {
+			if (stop_all) return false;
+			if (!mirror.contains(h)) span(h);
+		}
+		return mirror_band();
+	};
 
-			info.rendered = true;
+	if (!pass([&](int h) { renderSpan(h, 0, width, view); })) return;
+
+	if (adaptive) {
+		// sample_count counts passes here, pixels hold anything between 1 and total samples
+		for (sample_count = 1; auto queued = planAdaptivePass(mirror, total, per_pass); ++sample_count) {
+			refineQueued(0, queued, view, total, per_pass);
+			if (!mirror_band()) return;
 		}
+		return;
 	}
+
+	for (sample_count = 1; sample_count < total; sample_count = min(sample_count + per_pass, total))
+		if (!pass([&](int h) { sampleSpan(h, 0, width, view, total, per_pass); })) return;
 }
 
-void Mandelbrot::update(bool rerender_all, bool clear_surface)
+void Mandelbrot::drawPreview()
 {
-	stop();
-	updated = false;
+	auto view = getViewport();
 
-	if (rerender_all)
-		render_info.reset();
-	if (clear_surface)
-		SDL_FillRect(surface, nullptr, 0x00000000);
+	for (int h = 0; h < height; h += preview_block) {
+		if (stop_all) return;
+		iteration_count += previewRow(h, view);
+	}
 }
 
-void Mandelbrot::RenderInfo::resize(uint32_t width, uint32_t height)
+// the blocks of preview_block rows from h on, each sampled at its center if any of its pixels
+// needs it. the pixels stay not rendered, so the next full frame replaces them.
+uint64_t Mandelbrot::previewRow(int h, const Viewport& view)
 {
-	if (pixels) destroy();
-	pixels       = new PixelInfo[width * height];
-	this->width  = width;
-	this->height = height;
+	uint64_t iterations = 0;
+	int      h_end      = SDL_min(h + preview_block, height);
+
+	for (int x = 0; x < width; x += preview_block) {
+		int  w_end   = SDL_min(x + preview_block, width);
+		bool sampled = false;
+		uint32_t color = 0;
+
+		for (int y = h; y < h_end; ++y) {
+			auto* row = (uint32_t*)surface->pixels + y * surface->w;
+			for (int w = x; w < w_end; ++w) {
+				if (render_info.rendered(w, y)) continue;
+				if (!sampled) {
+					color   = samplePixel(x + preview_block / 2., h + preview_block / 2., view, iterations);
+					sampled = true;
+				}
+				row[w] = color;
+			}
+		}
+	}
+	return iterations;
+}
+
+// a drag is extrapolated from the moves of the last pan_window seconds, the band it is about to
+// uncover is as wide as it goes in prefetch_lookahead seconds, up to half the window
+static constexpr double pan_window         = .1;
+static constexpr double prefetch_lookahead = .25;
+
+void Mandelbrot::startPrefetch()
+{
+	TRACE_SCOPE("plan prefetch");
+	prefetch_queue.clear();
+	if (preview) return;
+
+	auto view = getViewport();
+
+	// a move by rel_px > 0 shifts the image right, the new pixels come in on the left
+	real_t vx, vy;
+	getPanVelocity(vx, vy);
+
+	int bx = (int)SDL_min(fabs(vx) * prefetch_lookahead, width / 2.);
+	int by = (int)SDL_min(fabs(vy) * prefetch_lookahead, height / 2.);
+	if (bx > 0) queuePrefetch(view, vx > 0. ? SDL_Rect{ -bx, 0, bx, height } : SDL_Rect{ width, 0, bx, height });
+	if (by > 0) queuePrefetch(view, vy > 0. ? SDL_Rect{ 0, -by, width, by } : SDL_Rect{ 0, height, width, by });
+
+	// the same wheel step once more first, then the one back
+	if (zoom_step.factor != 1.) {
+		queuePrefetch(getScaledViewport(scale * zoom_step.factor, zoom_step.px, zoom_step.py), { 0, 0, width, height });
+		queuePrefetch(getScaledViewport(scale / zoom_step.factor, zoom_step.px, zoom_step.py), { 0, 0, width, height });
+	}
+
+	if (prefetch_queue.empty()) return;
+
+	if (!worker.joinable())
+		worker = thread(&Mandelbrot::workerLoop, this);
+
+	{
+		lock_guard<mutex> guard(worker_lock);
+		prefetch_pending = true;
+	}
+	worker_signal.notify_all();
 }
 
-void Mandelbrot::RenderInfo::reset(PixelInfo info)
+// the worker leaves the tile it is on at its next row, that one stays not ready
+void Mandelbrot::stopPrefetch()
 {
-	if (pixels) fill_n(pixels, width * height, info);
+	unique_lock<mutex> guard(worker_lock);
+	prefetch_pending = false;
+	if (!prefetching) return;
+
+	TRACE_SCOPE("stop prefetch");
+	stop_all = true;
+	worker_signal.wait(guard, [this] { return !prefetching; });
+	stop_all = false;
 }
 
-void Mandelbrot::RenderInfo::move(int32_t rel_px, int32_t rel_py)
+void Mandelbrot::runPrefetch()
 {
-	if (!pixels) return;
+	TRACE_SCOPE("prefetch");
+	for (auto i : prefetch_queue) {
+		auto& tile = prefetch_tiles[i];
 
-	if (rel_px >= 0 && rel_py >= 0) {
-		for (int h = height - rel_py - 1; h >= 0; --h) 
-			std::move_backward(&at(0, h), &at(width - rel_px, h), &at(width, h + rel_py));
-	} else if (rel_px >= 0 && rel_py <= 0) {
-		for (int h = -rel_py; h < height; ++h) 
-			std::move_backward(&at(0, h), &at(width - rel_px, h), &at(width, h + rel_py));
-	} else if (rel_px <= 0 && rel_py >= 0) {
-		for (int h = height - rel_py - 1; h >= 0; --h) 
-			std::move(&at(-rel_px, h), &at(width, h), &at(0, h + rel_py));
-	} else if (rel_px <= 0 && rel_py <= 0) {
-		for (int h = -rel_py; h < height; ++h) 
-			std::move(&at(-rel_px, h), &at(width, h), &at(0, h + rel_py));
+		drawPrefetch(tile);
+		if (stop_all) return;
+
+		tile.ready         = true;
+		prefetch_rendered += (uint64_t)tile.rect.w * tile.rect.h;
 	}
 }
 
-void Mandelbrot::RenderInfo::fillRect(SDL_Rect* rect, PixelInfo info)
+void Mandelbrot::drawPrefetch(PrefetchTile& tile)
 {
-	if (!pixels) return;
+	for (int y = 0; y < tile.rect.h; ++y) {
+		if (stop_all) return;
+		prefetchRow(tile, y);
+	}
+}
 
-	int h_min  = SDL_clamp(rect->y, 0, height);
-	int h_max  = SDL_clamp(rect->y + rect->h, 0, height);
-	int w_min  = SDL_clamp(rect->x, 0, width);
-	int w_size = SDL_clamp(rect->x + rect->w, 0, width) - rect->x;
+// the first sample of each pixel, at its center as renderSpan() takes it. deep views spend long
+// enough on a row for a drag to notice, so this one gives way between any two pixels.
+void Mandelbrot::prefetchRow(PrefetchTile& tile, int y)
+{
+	auto*    row        = tile.pixels.data + (size_t)y * tile.rect.w;
+	uint64_t iterations = 0;
 
-	for (int h = h_min; h < h_max; ++h)
-		fill_n(&at(w_min, h), w_size, info);
+	for (int x = 0; x < tile.rect.w && !stop_all; ++x)
+		row[x] = samplePixel(tile.rect.x + x + 0.5, tile.rect.y + y + 0.5, tile.view, iterations);
 }
 
-void Mandelbrot::RenderInfo::destroy()
+// a tile of its own for rect of view, a free one or else the least recently used one, as long as
+// the cache fits the budget with it. the parts of rect other tiles already hold are left out.
+void Mandelbrot::queuePrefetch(const Viewport& view, SDL_Rect rect)
+{
+	trimPrefetched(view, rect);
+	if (rect.w <= 0 || rect.h <= 0) return;
+
+	size_t i = max_prefetch_tiles;
+	for (size_t j = 0; j < prefetch_tiles.size(); ++j) {
+		if (find(prefetch_queue.begin(), prefetch_queue.end(), j) != prefetch_queue.end()) continue;
+		if (i == max_prefetch_tiles || !prefetch_tiles[j].ready ||
+			(prefetch_tiles[i].ready && prefetch_tiles[j].last_used < prefetch_tiles[i].last_used))
+			i = j;
+	}
+	if (i == max_prefetch_tiles) return;
+
+	auto&  tile  = prefetch_tiles[i];
+	size_t count = (size_t)rect.w * rect.h;
+
+	while (getPrefetchBytes() - tile.pixels.getBytes() + count * sizeof(uint32_t) > prefetch_budget)
+		if (!evictPrefetch(i)) return;
+
+	// exactly the size asked for, growing by a quarter more could go over the budget
+	if (tile.pixels.capacity < count || getPrefetchBytes() > prefetch_budget)
+		tile.pixels.allocate(count);
+	tile.pixels.count = count;
+
+	tile.ready       = false;
+	tile.view        = view;
+	tile.rect        = rect;
+	tile.iter        = iter;
+	tile.color_idx   = color_idx;
+	tile.color_scale = color_scale;
+	tile.smooth      = smooth;
+	tile.last_used   = ++prefetch_clock;
+	prefetch_queue.push_back(i);
+}
+
+// [begin, begin + size) without the ends [cover, cover + cover_size) overlaps
+static void cutSpan(int& begin, int& size, int cover, int cover_size)
+{
+	int end = begin + size, cover_end = cover + cover_size;
+
+	if (cover <= begin && cover_end > begin) begin = SDL_min(cover_end, end);
+	if (cover_end >= end && cover < end) end = SDL_max(cover, begin);
+	size = end - begin;
+}
+
+// tiles that span all of rect one way cut off the ends of it they hold the other way, a drag in
+// progress that way only needs the band past the one it already has
+void Mandelbrot::trimPrefetched(const Viewport& view, SDL_Rect& rect) const
 {
-	delete pixels;
-	pixels = nullptr;
-}
\ No newline at end of file
+	for (bool cut = true; cut && rect.w > 0 && rect.h > 0;) {
+		cut = false;
+		for (auto& tile : prefetch_tiles) {
+			int ox, oy;
+			if (!matchPrefetch(tile, view, ox, oy)) continue;
+
+			SDL_Rect held = { tile.rect.x + ox, tile.rect.y + oy, tile.rect.w, tile.rect.h };
+			SDL_Rect was  = rect;
+
+			if (held.y <= rect.y && held.y + held.h >= rect.y + rect.h) cutSpan(rect.x, rect.w, held.x, held.w);
+			if (held.x <= rect.x && held.x + held.w >= rect.x + rect.w) cutSpan(rect.y, rect.h, held.y, held.h);
+			cut |= rect.x != was.x || rect.y != was.y || rect.w != was.w || rect.h != was.h;
+		}
+	}
+}
+
+// pixels of the view that a tile holds count as rendered, the frame leaves them alone
+void Mandelbrot::adoptPrefetched()
+{
+	auto view = getViewport();
+
+	for (auto& tile : prefetch_tiles) {
+		int ox, oy;
+		if (!matchPrefetch(tile, view, ox, oy)) continue;
+
+		int x_begin = SDL_max(tile.rect.x + ox, 0), x_end = SDL_min(tile.rect.x + tile.rect.w + ox, width);
+		int y_begin = SDL_max(tile.rect.y + oy, 0), y_end = SDL_min(tile.rect.y + tile.rect.h + oy, height);
+		if (x_begin >= x_end || y_begin >= y_end) continue;
+
+		TRACE_SCOPE("adopt prefetch");
+		for (int h = y_begin; h < y_end; ++h) {
+			auto* src = tile.pixels.data + (size_t)(h - oy - tile.rect.y) * tile.rect.w;
+			auto* row = (uint32_t*)surface->pixels + h * surface->w;
+
+			for (int word = x_begin / 64; word * 64 < x_end; ++word) {
+				for (auto todo = render_info.claim(h, word, x_begin, x_end); todo; todo &= todo - 1) {
+					int w = word * 64 + countTrailingZeros(todo);
+
+					row[w] = src[w - ox - tile.rect.x];
+					render_info.setFirstSample(w, h, row[w]);
+					++prefetch_hits;
+				}
+			}
+		}
+		tile.last_used = ++prefetch_clock;
+	}
+}
+
+bool Mandelbrot::evictPrefetch(size_t keep)
+{
+	size_t oldest = max_prefetch_tiles;
+	for (size_t i = 0; i < prefetch_tiles.size(); ++i) {
+		auto& tile = prefetch_tiles[i];
+		if (i == keep || !tile.pixels.capacity) continue;
+		if (find(prefetch_queue.begin(), prefetch_queue.end(), i) != prefetch_queue.end()) continue;
+		if (oldest == max_prefetch_tiles || !tile.ready ||
+			(prefetch_tiles[oldest].ready && tile.last_used < prefetch_tiles[oldest].last_used))
+			oldest = i;
+	}
+	if (oldest == max_prefetch_tiles) return false;
+
+	prefetch_tiles[oldest].pixels.free();
+	prefetch_tiles[oldest].ready = false;
+	return true;
+}
+
+void Mandelbrot::freePrefetch()
+{
+	prefetch_queue.clear();
+	for (auto& tile : prefetch_tiles) {
+		tile.pixels.free();
+		tile.ready = false;
+	}
+}
+
+// whether tile holds pixels of view: same colors, same pixel size and a whole number of pixels
+// apart. pixel (x, y) of the tile is pixel (x + ox, y + oy) of the view.
+bool Mandelbrot::matchPrefetch(const PrefetchTile& tile, const Viewport& view, int& ox, int& oy) const
+{
+	if (!tile.ready || tile.view.precision != view.precision) return false;
+	if (tile.iter != iter || tile.color_idx != color_idx || tile.color_scale != color_scale || tile.smooth != smooth) return false;
+	if (fabs(tile.view.dx - view.dx) > 1e-9 * view.dx || fabs(tile.view.dy - view.dy) > 1e-9 * view.dy) return false;
+
+	real_t fx = (real_t)(tile.view.min_x - view.min_x) / view.dx;
+	real_t fy = (real_t)(view.max_y - tile.view.max_y) / view.dy;
+	if (!(fabs(fx) < 1 << 24 && fabs(fy) < 1 << 24)) return false;
+
+	ox = (int)lround(fx);
+	oy = (int)lround(fy);
+	return fabs(fx - ox) < 1e-3 && fabs(fy - oy) < 1e-3;
+}
+
+// pixels per second
+void Mandelbrot::getPanVelocity(real_t& vx, real_t& vy) const
+{
+	auto since = chrono::steady_clock::now() - chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(pan_window));
+
+	vx = vy = 0.;
+	for (auto& step : pan_steps) {
+		if (step.time < since) continue;
+		vx += step.rel_px / pan_window;
+		vy += step.rel_py / pan_window;
+	}
+}
+
+Mandelbrot::Viewport Mandelbrot::getViewport() const
+{
+	return getViewport(scale, pos_x, pos_y);
+}
+
+Mandelbrot::Viewport Mandelbrot::getViewport(real_t scale, const pos_t& pos_x, const pos_t& pos_y) const
+{
+	return {
+		pos_x - pos_t(2. * scale * aspect),
+		getMaxY(scale, pos_y),
+		4. * scale * aspect / width,
+		4. * scale / height,
+		getActivePrecision(scale, pos_x, pos_y)
+	};
+}
+
+uint64_t Mandelbrot::renderSpan(int h, int w_begin, int w_end, const Viewport& view)
+{
+	constexpr int lanes = 8;
+
+	switch (view.precision) {
+	case Precision::Fixed128: return renderSpanFixed<2>(h, w_begin, w_end, view);
+	case Precision::Fixed192: return renderSpanFixed<3>(h, w_begin, w_end, view);
+	case Precision::Fixed256: return renderSpanFixed<4>(h, w_begin, w_end, view);
+	default: break;
+	}
+
+	auto* row = (uint32_t*)surface->pixels + h * surface->w;
+
+	uint64_t iterations = 0, computed = 0, colorize = 0;
+	bool     timed      = metrics && h % colorize_sample_rows == 0;
+
+	if (view.precision == Precision::Double) {
+		real_t min_x = (real_t)view.min_x;
+		real_t cy    = (real_t)view.max_y - view.dy * (h + 0.5f);
+
+		for (int word = w_begin / 64; word * 64 < w_end; ++word) {
+			for (auto todo = render_info.claim(h, word, w_begin, w_end); todo; todo &= todo - 1) {
+				int w = word * 64 + countTrailingZeros(todo);
+
+				real_t zx = min_x + view.dx * (w + 0.5f);
+				real_t zy = cy;
+
+				auto iterated = mandelbrot<real_t>(zx, zy, iter);
+				iterations   += iterated;
+				++computed;
+
+				row[w] = timed ? getColorTimed(colorize, iterated, zx, zy) : getColor(iterated, zx, zy);
+				render_info.setFirstSample(w, h, row[w]);
+			}
+		}
+
+		iteration_count += iterations;
+		pixels_computed += computed;
+		colorize_ns     += colorize;
+		return iterations;
+	}
+
+	// double-double: gather unrendered pixels into lanes and iterate them together
+	pos_t    cx[lanes], cy[lanes];
+	int      ws[lanes];
+	uint32_t iterated[lanes];
+	real_t   zx[lanes], zy[lanes];
+
+	pos_t row_y = view.max_y - pos_t(view.dy * (h + 0.5));
+
+	// unrendered pixels come a word of the bitmap at a time, lanes fill across words
+	int      word = w_begin / 64 - 1;
+	uint64_t todo = 0;
+
+	for (;;) {
+		int count = 0;
+		while (count < lanes) {
+			if (!todo) {
+				if (++word * 64 >= w_end) break;
+				todo = render_info.claim(h, word, w_begin, w_end);
+				continue;
+			}
+
+			int w = word * 64 + countTrailingZeros(todo);
+			todo &= todo - 1;
+
+			ws[count] = w;
+			cx[count] = view.min_x + pos_t(view.dx * (w + 0.5));
+			cy[count] = row_y;
+			++count;
+		}
+
+		if (count == 0) break;
+		for (int l = count; l < lanes; ++l) { // pad with copies of the last pixel
+			cx[l] = cx[count - 1];
+			cy[l] = cy[count - 1];
+		}
+
+		mandelbrot_soa<lanes>(cx, cy, iter, iterated, zx, zy);
+
+		for (int l = 0; l < count; ++l) {
+			row[ws[l]] = timed ? getColorTimed(colorize, iterated[l], zx[l], zy[l]) : getColor(iterated[l], zx[l], zy[l]);
+			render_info.setFirstSample(ws[l], h, row[ws[l]]);
+			iterations += iterated[l];
+		}
+		computed += count;
+	}
+
+	iteration_count += iterations;
+	pixels_computed += computed;
+	colorize_ns     += colorize;
+	return iterations;
+}
+
+template <int N>
+uint64_t Mandelbrot::renderSpanFixed(int h, int w_begin, int w_end, const Viewport& view)
+{
+	auto* row = (uint32_t*)surface->pixels + h * surface->w;
+	auto cy   = view.max_y - pos_t(view.dy * (h + 0.5));
+
+	uint64_t iterations = 0, computed = 0, colorize = 0;
+	bool     timed      = metrics && h % colorize_sample_rows == 0;
+
+	for (int word = w_begin / 64; word * 64 < w_end; ++word) {
+		for (auto todo = render_info.claim(h, word, w_begin, w_end); todo; todo &= todo - 1) {
+			int w = word * 64 + countTrailingZeros(todo);
+
+			auto cx = view.min_x + pos_t(view.dx * (w + 0.5));
+
+			real_t zx, zy;
+			auto iterated = mandelbrot<N>(cx, cy, iter, zx, zy);
+			iterations   += iterated;
+			++computed;
+
+			row[w] = timed ? getColorTimed(colorize, iterated, zx, zy) : getColor(iterated, zx, zy);
+			render_info.setFirstSample(w, h, row[w]);
+		}
+	}
+
+	iteration_count += iterations;
+	pixels_computed += computed;
+	colorize_ns     += colorize;
+	return iterations;
+}
+
+void Mandelbrot::sampleSpan(int h, int w_begin, int w_end, const Viewport& view, uint32_t total, uint32_t per_pass)
+{
+	for (int w = w_begin; w < w_end; ++w) {
+		if (stop_all) return;
+
+		auto count = render_info.getSampleCount(w, h);
+		if (count >= total) continue;
+
+		refinePixel(w, h, view, min(total - count, per_pass));
+	}
+}
+
+// only while render_info has its sample planes
+void Mandelbrot::refinePixel(int w, int h, const Viewport& view, uint32_t count)
+{
+	auto pixel = (uint32_t)(h * width + w);
+
+	uint64_t iterations = 0;
+
+	// the centered first sample is not part of the sequence, jittered ones start at index 1
+	for (uint32_t i = 0; i < count; ++i) {
+		float x, y;
+		sampling::sample2D(sample_sequence, pixel, render_info.sample_count[pixel], sample_seed, x, y);
+		render_info.addSample(w, h, samplePixel(w + x, h + y, view, iterations));
+	}
+
+	((uint32_t*)surface->pixels)[h * surface->w + w] = render_info.getColor(w, h);
+	refined_samples += count;
+	iteration_count += iterations;
+}
+
+// queues the pixels whose luminance is still uncertain, worst first. a pixel with too few
+// samples for a variance estimate is judged by the contrast to its neighbours instead, so
+// flat bands and solid interior stop after the first sample while edges get refined.
+size_t Mandelbrot::planAdaptivePass(const Mirror& mirror, uint32_t total, uint32_t per_pass)
+{
+	adaptive_queue.clear();
+
+	auto* pixels = (uint32_t*)surface->pixels;
+	auto tol     = (float)sample_tolerance;
+
+	for (int h = 0; h < height; ++h) {
+		if (stop_all) return 0;
+		if (mirror.contains(h)) continue;
+
+		for (int w = 0; w < width; ++w) {
+			auto count = render_info.getSampleCount(w, h);
+			if (!count || count >= total) continue;
+
+			// standard error of the mean luminance
+			float priority = sqrtf(render_info.getVariance(w, h) / count);
+
+			if (count < adaptive_min_samples) {
+				auto lum = luminance(pixels[h * surface->w + w]);
+				if (w > 0)          priority = SDL_max(priority, fabsf(lum - luminance(pixels[h * surface->w + w - 1])));
+				if (w < width - 1)  priority = SDL_max(priority, fabsf(lum - luminance(pixels[h * surface->w + w + 1])));
+				if (h > 0)          priority = SDL_max(priority, fabsf(lum - luminance(pixels[(h - 1) * surface->w + w])));
+				if (h < height - 1) priority = SDL_max(priority, fabsf(lum - luminance(pixels[(h + 1) * surface->w + w])));
+			}
+
+			if (priority > tol)
+				adaptive_queue.push_back({ priority, (uint32_t)(h * width + w) });
+		}
+	}
+
+	size_t budget = SDL_max(sample_budget / SDL_max(per_pass, 1u), 1u);
+	if (adaptive_queue.size() > budget) {
+		nth_element(adaptive_queue.begin(), adaptive_queue.begin() + budget, adaptive_queue.end(), greater<>());
+		adaptive_queue.resize(budget);
+	}
+
+	return adaptive_queue.size();
+}
+
+void Mandelbrot::refineQueued(size_t begin, size_t end, const Viewport& view, uint32_t total, uint32_t per_pass)
+{
+	for (size_t i = begin; i < end; ++i) {
+		if (stop_all) return;
+
+		auto idx   = adaptive_queue[i].second;
+		auto count = render_info.getSampleCount(idx % width, idx / width);
+		refinePixel(idx % width, idx / width, view, min(total - count, per_pass));
+	}
+}
+
+void Mandelbrot::getTileCosts(vector<TileCost>& tiles) const
+{
+	lock_guard<mutex> guard(tiles_lock);
+	tiles.assign(tiles_last.begin(), tiles_last.begin() + tiles_last_count);
+}
+
+void Mandelbrot::recordTile(const SDL_Rect& rect, chrono::steady_clock::time_point start, uint64_t iterations)
+{
+	auto idx = tiles_next_count++;
+	if (idx >= max_tile_costs) return;
+
+	auto& tile      = tiles_next[idx];
+	tile.rect       = rect;
+	tile.ns         = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+	tile.iterations = iterations;
+	tile.thread     = tbb::this_task_arena::current_thread_index();
+}
+
+void Mandelbrot::drawOverlay()
+{
+	using range_t = tbb::blocked_range<int>;
+
+	if (overlay != Overlay::SampleCount) return drawTileOverlay();
+
+	// samples per pixel on a log scale, from one sample (blue) up to sample_total (red)
+	auto total = SDL_max(sample_total, 2u);
+	auto norm  = 255.f / log2f((float)total);
+
+	tbb::parallel_for(range_t(0, height), [=](const range_t& r) {
+		for (int h = r.begin(); h < r.end(); ++h) {
+			auto* row = (uint32_t*)surface_overlay->pixels + h * surface_overlay->w;
+
+			for (int w = 0; w < width; ++w) {
+				auto count = render_info.getSampleCount(w, h);
+				row[w]     = count ? colormap[5][(int)SDL_min(norm * log2f((float)count), 255.f)] : 0xff000000;
+			}
+		}
+	});
+}
+
+// the image at half brightness with every tile blended in, its top and left edge darker so
+// the split stays visible where neighbours have about the same cost
+void Mandelbrot::drawTileOverlay()
+{
+	using range_t = tbb::blocked_range<int>;
+
+	// few enough to tell apart, the slots past them repeat the colors
+	static const uint32_t thread_colors[] = {
+		0xe6194b, 0x3cb44b, 0xffe119, 0x4363d8, 0xf58231, 0x911eb4,
+		0x46f0f0, 0xf032e6, 0xbcf60c, 0xfabebe, 0x008080, 0xe6beff
+	};
+
+	tbb::parallel_for(range_t(0, height), [this](const range_t& r) {
+		for (int h = r.begin(); h < r.end(); ++h) {
+			auto* src = (uint32_t*)surface->pixels + h * surface->w;
+			auto* dst = (uint32_t*)surface_overlay->pixels + h * surface_overlay->w;
+			for (int w = 0; w < width; ++w)
+				dst[w] = 0xff000000 | (src[w] >> 1 & 0x7f7f7f);
+		}
+	});
+
+	lock_guard<mutex> guard(tiles_lock);
+
+	// per pixel, so tiles of different sizes compare
+	auto value = [this](const TileCost& tile) {
+		auto cost = overlay == Overlay::TileTime ? tile.ns : tile.iterations;
+		return log2f(1.f + (float)cost / SDL_max(tile.rect.w * tile.rect.h, 1));
+	};
+
+	float lo = FLT_MAX, hi = 0.f;
+	for (uint32_t i = 0; i < tiles_last_count; ++i) {
+		lo = SDL_min(lo, value(tiles_last[i]));
+		hi = SDL_max(hi, value(tiles_last[i]));
+	}
+	auto norm = hi > lo ? 255.f / (hi - lo) : 0.f;
+
+	tbb::parallel_for(range_t(0, tiles_last_count), [&](const range_t& r) {
+		for (int i = r.begin(); i < r.end(); ++i) {
+			auto& tile = tiles_last[i];
+			auto color = overlay == Overlay::TileThread
+				? thread_colors[SDL_max(tile.thread, 0) % size(thread_colors)]
+				: colormap[5][(int)SDL_clamp(norm * (value(tile) - lo), 0.f, 255.f)];
+
+			auto fill = color >> 1 & 0x7f7f7f;
+			auto edge = color >> 2 & 0x3f3f3f;
+
+			for (int h = tile.rect.y; h < tile.rect.y + tile.rect.h && h < height; ++h) {
+				auto* row = (uint32_t*)surface_overlay->pixels + h * surface_overlay->w;
+				for (int w = tile.rect.x; w < tile.rect.x + tile.rect.w && w < width; ++w)
+					row[w] = h == tile.rect.y || w == tile.rect.x ? 0xff000000 | edge : row[w] + fill;
+			}
+		}
+	});
+}
+
+// one sample at pixel coordinates (px, py), without the batching of renderSpan
+uint32_t Mandelbrot::samplePixel(real_t px, real_t py, const Viewport& view, uint64_t& iterations) const
+{
+	auto cx = view.min_x + pos_t(view.dx * px);
+	auto cy = view.max_y - pos_t(view.dy * py);
+
+	real_t zx, zy;
+	uint32_t iterated;
+
+	switch (view.precision) {
+	case Precision::DoubleDouble:
+		iterated = mandelbrot<pos_t>(cx, cy, iter, zx, zy);
+		break;
+	case Precision::Fixed128:
+		iterated = mandelbrot<2>(cx, cy, iter, zx, zy);
+		break;
+	case Precision::Fixed192:
+		iterated = mandelbrot<3>(cx, cy, iter, zx, zy);
+		break;
+	case Precision::Fixed256:
+		iterated = mandelbrot<4>(cx, cy, iter, zx, zy);
+		break;
+	default:
+		iterated = mandelbrot<real_t>((real_t)cx, (real_t)cy, iter, zx, zy);
+		break;
+	}
+
+	iterations += iterated;
+	return getColor(iterated, zx, zy);
+}
+
+uint32_t Mandelbrot::getColor(uint32_t iterated, real_t zx, real_t zy) const
+{
+	if (iterated == iter)
+		return 0xff000000;
+	if (!smooth)
+		return colormap[color_idx][(int)(color_scale * 256 * iterated / iter) % 256];
+
+	double log_zn  = log(zx * zx + zy * zy) / 2.;
+	double nu      = log(log_zn / log(2)) / log(2);
+	auto real_iter = iterated + 3.5 - nu;
+
+	auto col1 = colormap[color_idx][(int)(color_scale * 256 * real_iter / iter) % 256];
+	auto col2 = colormap[color_idx][(int)(color_scale * 256 * (real_iter + 1) / iter) % 256];
+
+	return lerp_color(col1, col2, fmod(iter, 1));
+}
+
+// what a pair of clock reads costs on its own, so it can be taken out of the timed colors
+static int64_t clockOverhead()
+{
+	int64_t best = INT64_MAX;
+	for (int i = 0; i < 256; ++i) {
+		auto start = chrono::steady_clock::now();
+		best = min<int64_t>(best, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+uint32_t Mandelbrot::getColorTimed(uint64_t& ns, uint32_t iterated, real_t zx, real_t zy) const
+{
+	static const int64_t overhead = clockOverhead();
+
+	auto start = chrono::steady_clock::now();
+	auto color = getColor(iterated, zx, zy);
+	auto spent = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+	ns += max<int64_t>(spent - overhead, 0);
+	return color;
+}
+
+// how far, in pixels, a mirrored sample may lie from where the pixel would have sampled
+static constexpr real_t mirror_tolerance = 1e-3;
+
+Mandelbrot::Mirror Mandelbrot::getMirror() const
+{
+	auto view = getViewport();
+
+	// row h samples cy = max_y - dy * (h + 0.5), so rows h and h' mirror each other when h + h' = 2 * max_y / dy - 1.
+	// copying row k - h to row h moves the sample by k - axis pixels. getMaxY() puts the axis on a
+	// whole k whenever it is near the screen, what is left is rounding.
+	real_t axis = 2. * (real_t)view.max_y / view.dy - 1.;
+	if (!in_range<real_t>(axis, 1., 2. * height)) return {};
+
+	int k = (int)round(axis);
+	if (fabs(axis - k) > mirror_tolerance) return {};
+
+	int begin = k / 2 + 1;
+	int end   = SDL_min(k, height - 1) + 1;
+	if (begin >= end) return {};
+
+	return { begin, end, k };
+}
+
+void Mandelbrot::mirrorRow(int h, const Mirror& mirror)
+{
+	int src_h = mirror.axis - h;
+
+	auto* src = (uint32_t*)surface->pixels + src_h * surface->w;
+	auto* dst = (uint32_t*)surface->pixels + h * surface->w;
+
+	auto* src_bits = render_info.row(src_h);
+	auto* dst_bits = render_info.row(h);
+
+	uint64_t mirrored = 0;
+
+	// a whole row belongs to this task, so its words can be written without a read-modify-write
+	for (int word = 0; word < (int)render_info.stride; ++word) {
+		auto src_word = src_bits[word].load(memory_order_relaxed);
+		auto dst_word = dst_bits[word].load(memory_order_relaxed);
+		auto todo     = src_word & ~dst_word;
+
+		mirrored += popCount(todo);
+		dst_bits[word].store(dst_word | todo, memory_order_relaxed);
+
+		if (render_info.hasSamplePlanes()) {
+			// pixels the source has more samples of, not only new ones
+			for (int w = word * 64; w < SDL_min(word * 64 + 64, width); ++w) {
+				auto src_idx = src_h * width + w, dst_idx = h * width + w;
+				if (render_info.sample_count[dst_idx] >= render_info.sample_count[src_idx]) continue;
+
+				dst[w] = src[w];
+				render_info.sample_count[dst_idx] = render_info.sample_count[src_idx];
+				render_info.accum[dst_idx]        = render_info.accum[src_idx];
+			}
+			continue;
+		}
+
+		for (; todo; todo &= todo - 1) {
+			int w  = word * 64 + countTrailingZeros(todo);
+			dst[w] = src[w];
+		}
+	}
+
+	pixels_mirrored += mirrored;
+}
+
+void Mandelbrot::update(bool rerender_all, bool clear_surface)
+{
+	stop();
+	updated         = false;
+	sample_count    = 0;
+	refined_samples = 0;
+	iteration_count = 0;
+
+	if (rerender_all)
+		render_info.reset();
+	if (clear_surface)
+		SDL_FillRect(surface, nullptr, 0x00000000);
+
+	render_info.setSamplePlanes(usesSamplePlanes(), surface);
+
+	prefetch_planned = false;
+	adoptPrefetched();
+}
+
+bool Mandelbrot::usesSamplePlanes() const
+{
+	return sample_total > 1;
+}
+
+bool Mandelbrot::usesPrefetch() const
+{
+	return prefetch;
+}
+
+bool Mandelbrot::huge_pages = false;
+
+static constexpr size_t plane_alignment = 64;
+static constexpr size_t large_page_size = 2 << 20;
+
+static void* allocatePlane(size_t bytes, bool& large)
+{
+	large = false;
+	if (!bytes) return nullptr;
+
+#ifdef _WIN32
+	if (Mandelbrot::getHugePages() && bytes >= large_page_size) {
+		auto page = GetLargePageMinimum();
+		if (page) {
+			auto rounded = (bytes + page - 1) / page * page;
+			if (void* p = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE)) {
+				large = true;
+				return p;
+			}
+		}
+	}
+	auto* p = _aligned_malloc(bytes, plane_alignment);
+#else
+	void* p = nullptr;
+	if (Mandelbrot::getHugePages() && bytes >= large_page_size) {
+		auto rounded = (bytes + large_page_size - 1) / large_page_size * large_page_size;
+		if (posix_memalign(&p, large_page_size, rounded) == 0) {
+			madvise(p, rounded, MADV_HUGEPAGE); // a hint, transparent huge pages may be off
+			large = true;
+			return p;
+		}
+	}
+	if (posix_memalign(&p, plane_alignment, bytes) != 0) p = nullptr;
+#endif
+	if (!p) throw bad_alloc();
+	return p;
+}
+
+static void freePlane(void* p, bool large)
+{
+	if (!p) return;
+#ifdef _WIN32
+	if (large) VirtualFree(p, 0, MEM_RELEASE);
+	else _aligned_free(p);
+#else
+	(void)large; // posix_memalign and malloc memory alike
+	free(p);
+#endif
+}
+
+template <class T>
+void Mandelbrot::Plane<T>::allocate(size_t count)
+{
+	free();
+	data        = (T*)allocatePlane(count * sizeof(T), large);
+	this->count = count;
+	capacity    = count;
+	for (size_t i = 0; i < count; ++i) new (data + i) T();
+}
+
+template <class T>
+void Mandelbrot::Plane<T>::resize(size_t count)
+{
+	if (count > capacity) allocate(count + count / 4);
+	this->count = count;
+}
+
+template <class T>
+void Mandelbrot::Plane<T>::free()
+{
+	freePlane(data, large);
+	data     = nullptr;
+	count    = 0;
+	capacity = 0;
+}
+
+// a row of the bitmap of src_words words, shifted by rel_px pixels into a row of width pixels.
+// the padding of src is clear, the one of dst is cleared.
+static void shiftBits(const atomic<uint64_t>* src, int src_words, int rel_px, uint64_t* dst, int width)
+{
+	int words = (width + 63) / 64;
+	int shift = abs(rel_px) / 64, bit = abs(rel_px) % 64;
+
+	auto word = [&](int i) { return 0 <= i && i < src_words ? src[i].load(memory_order_relaxed) : 0; };
+
+	for (int i = 0; i < words; ++i) {
+		if (rel_px >= 0) dst[i] = word(i - shift) << bit | (bit ? word(i - shift - 1) >> (64 - bit) : 0);
+		else             dst[i] = word(i + shift) >> bit | (bit ? word(i + shift + 1) << (64 - bit) : 0);
+	}
+	if (words) dst[words - 1] &= bitRange(0, width - (words - 1) * 64);
+}
+
+// plane holds width x height values, pixel (x, y) of them moves to (x + ox, y + oy) of a
+// new_width x new_height plane, pixels it didn't have are default. it is done in place while the
+// storage holds both sizes: along the rows into their new length and across them by a block,
+// in the order that never overwrites what is still to be moved.
+template <class T>
+static void remapPlane(Mandelbrot::Plane<T>& plane, int width, int height, int new_width, int new_height, int ox, int oy)
+{
+	int    x_begin  = SDL_max(ox, 0), x_end = SDL_min(width + ox, new_width);
+	int    y_begin  = SDL_max(oy, 0), y_end = SDL_min(height + oy, new_height);
+	int    columns  = SDL_max(x_end - x_begin, 0);
+	int    rows     = columns ? SDL_max(y_end - y_begin, 0) : 0;
+	size_t new_size = (size_t)new_width * new_height;
+
+	if (SDL_max(plane.count, new_size) > plane.capacity) {
+		Mandelbrot::Plane<T> next;
+		next.resize(new_size);
+		for (int y = y_begin; y < y_begin + rows; ++y)
+			copy_n(plane.data + (size_t)(y - oy) * width + x_begin - ox, columns, next.data + (size_t)y * new_width + x_begin);
+
+		plane.free();
+		plane = next;
+		return;
+	}
+
+	auto* data = plane.data;
+
+	// the rows to keep are [0, rows) of the old plane here, they stay there
+	auto alongRows = [&] {
+		auto row = [&](int i) {
+			auto* src = data + (size_t)i * width + x_begin - ox;
+			auto* dst = data + (size_t)i * new_width + x_begin;
+			if (dst <= src) std::move(src, src + columns, dst);
+			else std::move_backward(src, src + columns, dst + columns);
+		};
+		if (new_width <= width) for (int i = 0; i < rows; ++i) row(i);
+		else for (int i = rows - 1; i >= 0; --i) row(i);
+	};
+
+	if (oy < 0) {
+		std::move(data + (size_t)-oy * width, data + (size_t)(rows - oy) * width, data);
+		alongRows();
+	} else {
+		alongRows();
+		std::move_backward(data, data + (size_t)rows * new_width, data + (size_t)(rows + oy) * new_width);
+	}
+
+	plane.resize(new_size);
+	for (int y = 0; y < new_height; ++y) {
+		auto* row = data + (size_t)y * new_width;
+		if (y < y_begin || y >= y_begin + rows) {
+			fill_n(row, new_width, T());
+		} else {
+			fill_n(row, x_begin, T());
+			fill_n(row + x_end, new_width - x_end, T());
+		}
+	}
+}
+
+// the new bitmap is laid out in bits_spare and swapped in, the planes only grow
+void Mandelbrot::RenderInfo::resize(uint32_t width, uint32_t height, int ox, int oy)
+{
+	uint32_t words = (width + 63) / 64;
+
+	bits_spare.resize((size_t)words * height);
+	scratch.resize(SDL_max(words, stride));
+
+	for (int h = 0; h < (int)height; ++h) {
+		int src = h - oy;
+		if (0 <= src && src < (int)this->height) shiftBits(row(src), (int)stride, ox, scratch.data, (int)width);
+		else fill_n(scratch.data, words, 0);
+
+		auto* dst = bits_spare.data + (size_t)h * words;
+		for (uint32_t i = 0; i < words; ++i) dst[i].store(scratch[i], memory_order_relaxed);
+	}
+	swap(bits, bits_spare);
+
+	if (hasSamplePlanes()) {
+		remapPlane(sample_count, this->width, this->height, width, height, ox, oy);
+		remapPlane(accum, this->width, this->height, width, height, ox, oy);
+	}
+
+	this->width  = width;
+	this->height = height;
+	stride       = words;
+}
+
+void Mandelbrot::RenderInfo::setSamplePlanes(bool enable, const SDL_Surface* surface)
+{
+	if (enable == hasSamplePlanes()) return;
+
+	if (!enable) {
+		sample_count.free();
+		accum.free();
+		return;
+	}
+
+	sample_count.allocate((size_t)width * height);
+	accum.allocate((size_t)width * height);
+	if (!surface) return;
+
+	for (uint32_t h = 0; h < height; ++h) {
+		auto* colors = (const uint32_t*)surface->pixels + h * surface->w;
+		for (uint32_t w = 0; w < width; ++w)
+			if (rendered(w, h)) addSample(w, h, colors[w]);
+	}
+}
+
+void Mandelbrot::RenderInfo::reset()
+{
+	for (size_t i = 0; i < bits.count; ++i) bits[i].store(0, memory_order_relaxed);
+	if (hasSamplePlanes()) {
+		fill_n(sample_count.data, sample_count.count, 0u);
+		fill_n(accum.data, accum.count, SampleAccum());
+	}
+}
+
+// rows of the bitmap are shifted by rel_px bits through the scratch row, which also makes
+// overlapping source and destination rows safe
+void Mandelbrot::RenderInfo::move(int32_t rel_px, int32_t rel_py)
+{
+	if (!bits.data) return;
+
+	auto shiftRow = [&](uint32_t h) {
+		shiftBits(row(h), (int)stride, rel_px, scratch.data, (int)width);
+
+		auto* dst = row(h + rel_py);
+		for (uint32_t i = 0; i < stride; ++i) dst[i].store(scratch[i], memory_order_relaxed);
+	};
+
+	if (rel_py >= 0) {
+		for (int h = height - rel_py - 1; h >= 0; --h) shiftRow(h);
+	} else {
+		for (int h = -rel_py; h < (int)height; ++h) shiftRow(h);
+	}
+
+	if (!hasSamplePlanes()) return;
+
+	auto movePlane = [&](auto* plane) {
+		auto at = [&](uint32_t px, uint32_t py) { return plane + py * width + px; };
+
+		if (rel_px >= 0 && rel_py >= 0) {
+			for (int h = (int)height - rel_py - 1; h >= 0; --h)
+				std::move_backward(at(0, h), at(width - rel_px, h), at(width, h + rel_py));
+		} else if (rel_px >= 0 && rel_py <= 0) {
+			for (int h = -rel_py; h < (int)height; ++h)
+				std::move_backward(at(0, h), at(width - rel_px, h), at(width, h + rel_py));
+		} else if (rel_px <= 0 && rel_py >= 0) {
+			for (int h = (int)height - rel_py - 1; h >= 0; --h)
+				std::move(at(-rel_px, h), at(width, h), at(0, h + rel_py));
+		} else if (rel_px <= 0 && rel_py <= 0) {
+			for (int h = -rel_py; h < (int)height; ++h)
+				std::move(at(-rel_px, h), at(width, h), at(0, h + rel_py));
+		}
+	};
+
+	movePlane(sample_count.data);
+	movePlane(accum.data);
+}
+
+void Mandelbrot::RenderInfo::fillRect(const SDL_Rect* rect)
+{
+	if (!bits.data) return;
+
+	int h_min = SDL_clamp(rect->y, 0, (int)height);
+	int h_max = SDL_clamp(rect->y + rect->h, 0, (int)height);
+	int w_min = SDL_clamp(rect->x, 0, (int)width);
+	int w_max = SDL_clamp(rect->x + rect->w, 0, (int)width);
+	if (w_min >= w_max) return;
+
+	for (int h = h_min; h < h_max; ++h) {
+		auto* bits = row(h);
+		for (int word = w_min / 64; word * 64 < w_max; ++word)
+			bits[word].fetch_and(~bitRange(SDL_max(w_min - word * 64, 0), SDL_min(w_max - word * 64, 64)), memory_order_relaxed);
+
+		if (hasSamplePlanes()) {
+			fill_n(sample_count.data + h * width + w_min, w_max - w_min, 0u);
+			fill_n(accum.data + h * width + w_min, w_max - w_min, SampleAccum());
+		}
+	}
+}
+
+void Mandelbrot::RenderInfo::destroy()
+{
+	bits.free();
+	bits_spare.free();
+	scratch.free();
+	sample_count.free();
+	accum.free();
+}
+
+size_t Mandelbrot::RenderInfo::getBytes() const
+{
+	return bits.getBytes() + bits_spare.getBytes() + scratch.getBytes() + sample_count.getBytes() + accum.getBytes();
+}
@@ -1,10 +1,21 @@
 #pragma once
 
 #include <complex>
-#include <future>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <SDL2/SDL.h>
 
+#include "dd_real.h"
+#include "fixed_point.h"
+#include "nucleus.h"
+#include "sampling.h"
+#include "metrics.h"
+#include "bits.h"
+
 template <class T>
 inline uint32_t mandelbrot(T& cx, T& cy, uint32_t max_iter) {
 	T cx_ = cx, cy_ = cy, zx = 0., zy = 0.;
@@ -22,31 +33,109 @@ inline uint32_t mandelbrot(T& cx, T& cy, uint32_t max_iter) {
 	return i;
 }
 
+// same as above, but leaves c untouched and hands back the escaped z in double
+template <class T>
+inline uint32_t mandelbrot(const T& cx, const T& cy, uint32_t max_iter, double& zx, double& zy) {
+	T x = cx, y = cy;
+	auto iterated = mandelbrot<T>(x, y, max_iter);
+
+	zx = (double)x;
+	zy = (double)y;
+
+	return iterated;
+}
+
 class Mandelbrot
 {
 public:
 	using real_t = double;
+	using pos_t  = dd_real;
+
+	enum class Precision {
+		Auto         = 0,
+		Double       = 1,
+		DoubleDouble = 2,
+		Fixed        = 3, // resolves to one of the widths below by zoom depth
+		Fixed128     = 4,
+		Fixed192     = 5,
+		Fixed256     = 6
+	};
+
+	// drawn instead of the image to show where the renderer spends its work
+	enum class Overlay {
+		None           = 0,
+		SampleCount    = 1,
+		TileTime       = 2, // the tile overlays show the tasks of the last finished render,
+		TileIterations = 3, // per pixel on a log scale, or by the worker that ran them
+		TileThread     = 4
+	};
+
+	// what one task of a render cost. recorded by the backends that split the image into tasks
+	// (TBB, bignum), only the first pass of a frame is: later passes revisit the same pixels.
+	struct TileCost {
+		SDL_Rect rect;
+		uint64_t ns;
+		uint64_t iterations;
+		int      thread; // slot in the task arena
+	};
+
+	// a render with more tasks than this drops the rest of them
+	static constexpr size_t max_tile_costs = 1 << 14;
 
+	// without a renderer the image only lives in getSurface() and draw() does nothing
+	Mandelbrot(int width, int height);
 	Mandelbrot(SDL_Renderer* renderer);
 	virtual ~Mandelbrot();
 
-	void render(bool async = true);
+	// frame_seconds is the time since the previous frame, the zoom animation advances by it
+	void render(bool async = true, double frame_seconds = 0.);
 	virtual void draw();
 
 	virtual void stop();
 	virtual void wait();
+	// also while a zoom animates, its frames are only reprojected
 	virtual bool isRendering() const;
 
-	virtual void resize();
+	virtual void resize(); // to the window size
+	// the pixels keep their size and the image stays centered, so the pixels both sizes share
+	// keep their colors and only the new ones are rendered
+	virtual void resize(int width, int height);
 
-	std::complex<real_t> getPosition() const { return { pos_x, pos_y }; }
-	void setPosition(real_t x, real_t y);
+	// for while the window is being resized: pixels not rendered yet are filled in blocks of
+	// preview_block x preview_block from one sample, they are rendered once it is turned off
+	static constexpr int preview_block = 4;
+	inline bool getPreview() const { return preview; }
+	void setPreview(bool preview);
+
+	inline int getWidth() const { return width; }
+	inline int getHeight() const { return height; }
+
+	std::complex<real_t> getPosition() const { return { (real_t)pos_x, (real_t)pos_y }; }
+	inline pos_t getPositionX() const { return pos_x; }
+	inline pos_t getPositionY() const { return pos_y; }
+	void setPosition(pos_t x, pos_t y);
 	virtual void move(int32_t rel_px, int32_t rel_py);
 
 	inline real_t getScale() const { return scale; };
 	void setScale(real_t scale);
 	void setScaleTo(real_t scale, real_t px, real_t py);
 
+	// setScaleTo() spread over seconds: render() shows the image the zoom started from,
+	// reprojected to the view of the moment, and only renders the final view. the seconds are
+	// counted in the frame times render() is given, so a replay of the same frames ends on the
+	// same views. a call while it runs continues from the view on screen, any other change of
+	// the view ends it right away.
+	void animateScaleTo(real_t scale, real_t px, real_t py, double seconds);
+	inline bool isAnimating() const { return zoom.active; }
+	// where the animation ends, the scale otherwise
+	inline real_t getTargetScale() const { return zoom.active ? zoom.to_scale : scale; }
+
+	// searches the view around pixel (px, py) for minibrot nuclei in the background,
+	// render() then moves the view onto the nearest one once the search is done
+	void findNucleus(real_t px, real_t py);
+	void snapToNucleus();
+	inline const NucleusFinder& getNucleusFinder() const { return nucleus_finder; }
+
 	inline uint32_t getIteration() const { return iter; }
 	void setIteration(uint32_t iter);
 
@@ -59,42 +148,302 @@ public:
 	inline bool getColorSmooth() const { return smooth; }
 	void setColorSmooth(bool val);
 
+	// the color of a sample that stopped after iterated iterations at z = (zx, zy)
+	uint32_t getColor(uint32_t iterated, real_t zx, real_t zy) const;
+
+	inline Precision getPrecision() const { return precision; }
+	void setPrecision(Precision precision);
+	Precision getActivePrecision() const;
+	// the one the view centered at (pos_x, pos_y) at scale renders in
+	Precision getActivePrecision(real_t scale, const pos_t& pos_x, const pos_t& pos_y) const;
+
+	// after the first full frame, passes of sample_per_launch jittered samples are added
+	// to every pixel until it holds sample_total of them
+	inline uint32_t getTotalSample() const { return sample_total; }
+	void setTotalSample(uint32_t sample);
+
+	inline uint32_t getSamplePerLaunch() const { return sample_per_launch; }
+	inline void setSamplePerLaunch(uint32_t sample) { sample_per_launch = sample; }
+
+	inline uint32_t getSampleCount() const { return sample_count; }
+
+	inline sampling::Sequence getSampleSequence() const { return sample_sequence; }
+	void setSampleSequence(sampling::Sequence sequence);
+
+	inline uint32_t getSampleSeed() const { return sample_seed; }
+	void setSampleSeed(uint32_t seed);
+
+	// adaptive sampling only refines pixels whose luminance is still uncertain by more than
+	// sample_tolerance, worst first and at most sample_budget samples per pass (CPU backends)
+	inline bool getAdaptiveSampling() const { return adaptive; }
+	void setAdaptiveSampling(bool val);
+
+	inline real_t getSampleTolerance() const { return sample_tolerance; }
+	void setSampleTolerance(real_t tolerance);
+
+	inline uint32_t getSampleBudget() const { return sample_budget; }
+	inline void setSampleBudget(uint32_t budget) { sample_budget = budget; }
+
+	inline uint64_t getRefinedSamples() const { return refined_samples; }
+
+	// iterations spent since the last parameter change, summed over all samples
+	inline uint64_t getIterationCount() const { return iteration_count; }
+
+	// every finished frame is reported to the metrics, if any. they must outlive the render.
+	inline FrameMetrics* getMetrics() const { return metrics; }
+	inline void setMetrics(FrameMetrics* metrics) { this->metrics = metrics; }
+
+	inline Overlay getOverlay() const { return overlay; }
+	inline void setOverlay(Overlay overlay) { this->overlay = overlay; }
+
+	// memory held by the per pixel bookkeeping
+	inline size_t getRenderInfoBytes() const { return render_info.getBytes(); }
+
+	// while the renderer idles after a frame, the worker renders where the view is likely to go
+	// next: the band a drag is about to uncover, from the velocity of the last move() calls, and
+	// the next wheel step at the pixel of the last setScaleTo() or animateScaleTo(), both ways.
+	// the tiles wait in a cache of at most the budget in bytes. any change of the view or of the
+	// parameters stops the prefetch at its next row, pixels of the new view a tile already holds
+	// count as rendered. off by default, the backends that can't use it ignore it.
+	inline bool getPrefetch() const { return prefetch; }
+	void setPrefetch(bool val);
+
+	inline size_t getPrefetchBudget() const { return prefetch_budget; }
+	void setPrefetchBudget(size_t bytes);
+
+	size_t getPrefetchBytes() const;
+	// pixels the prefetch rendered, and how many of them made it into a view
+	inline uint64_t getPrefetchedPixels() const { return prefetch_rendered; }
+	inline uint64_t getPrefetchHits() const { return prefetch_hits; }
+
+	// the tiles of the last finished render, into the storage tiles already has
+	void getTileCosts(std::vector<TileCost>& tiles) const;
+
 	std::complex<real_t> pixelToComplex(real_t px, real_t py) const;
+	void pixelToComplex(real_t px, real_t py, pos_t& cx, pos_t& cy) const;
 
 	const SDL_Surface* getSurface() const { return surface; }
 
 protected:
 	virtual void startAsync();
 	virtual void drawSurface();
+	virtual void drawPreview();
 	virtual void update(bool rerender_all = true, bool clear_surface = true);
 
+	// whether render_info needs its sample planes, update() allocates or frees them
+	virtual bool usesSamplePlanes() const;
+
+	// whether the backend renders with samplePixel()'s arithmetic, so prefetched tiles match
+	virtual bool usesPrefetch() const;
+
+	// surface and surface_temp, along with the planes of their pixels
+	void swapSurfaces();
+
+	// drawSurface() with the frame reported to the metrics, unless it was stopped
+	void renderFrame();
+
+	// runs the renders startAsync() hands it, one at a time
+	void workerLoop();
+
+	// rows in [begin, end) are the mirror image of row (axis - h) about the real axis
+	struct Mirror {
+		int begin = 0;
+		int end   = 0;
+		int axis  = 0;
+
+		inline bool contains(int h) const { return begin <= h && h < end; }
+	};
+
+	Mirror getMirror() const;
+	void mirrorRow(int h, const Mirror& mirror);
+
+	// pixel (w, h) is sampled at (min_x + dx * (w + 0.5), max_y - dy * (h + 0.5))
+	struct Viewport {
+		pos_t     min_x;
+		pos_t     max_y;
+		real_t    dx;
+		real_t    dy;
+		Precision precision;
+	};
+
+	Viewport getViewport() const;
+	Viewport getViewport(real_t scale, const pos_t& pos_x, const pos_t& pos_y) const;
+	// the top edge of the view centered on pos_y. it is moved by up to half a pixel so that the real
+	// axis falls on a pixel center or between two rows, whenever the axis is anywhere near the
+	// screen. mirroring then copies exact samples after any zoom or move.
+	pos_t getMaxY(real_t scale, const pos_t& pos_y) const;
+	// target shows image, which was drawn for view from, in the current view
+	void reprojectFrom(const Viewport& from, const SDL_Surface* image, SDL_Surface* target);
+
+	// the view at scale with point (x, y) under pixel (px, py)
+	void placeScale(real_t scale, const pos_t& x, const pos_t& y, real_t px, real_t py);
+	// the center of that view
+	void getScaledCenter(real_t scale, const pos_t& x, const pos_t& y, real_t px, real_t py, pos_t& cx, pos_t& cy) const;
+
+	void advanceAnimation(double frame_seconds);
+	// jumps to the end of the animation, reprojected but not rendered yet
+	void finishAnimation();
+
+	// the view setScaleTo(scale, px, py) would move to, without moving there
+	Viewport getScaledViewport(real_t scale, real_t px, real_t py) const;
+
+	struct PrefetchTile;
+
+	// plans the tiles for the current view and hands them to the worker, on the caller's thread
+	void startPrefetch();
+	void stopPrefetch();
+	void runPrefetch(); // on the worker
+	virtual void drawPrefetch(PrefetchTile& tile);
+	void prefetchRow(PrefetchTile& tile, int y);
+
+	void queuePrefetch(const Viewport& view, SDL_Rect rect);
+	void trimPrefetched(const Viewport& view, SDL_Rect& rect) const;
+	void adoptPrefetched();
+	// frees the least recently used tile that holds memory, other than keep and the queued ones
+	bool evictPrefetch(size_t keep);
+	void freePrefetch();
+	bool matchPrefetch(const PrefetchTile& tile, const Viewport& view, int& ox, int& oy) const;
+	void getPanVelocity(real_t& vx, real_t& vy) const;
+
+	// these return the iterations they spent
+	uint64_t renderSpan(int h, int w_begin, int w_end, const Viewport& view);
+	template <int N>
+	uint64_t renderSpanFixed(int h, int w_begin, int w_end, const Viewport& view);
+	uint64_t previewRow(int h, const Viewport& view);
+	void sampleSpan(int h, int w_begin, int w_end, const Viewport& view, uint32_t total, uint32_t per_pass);
+	void refinePixel(int w, int h, const Viewport& view, uint32_t count);
+
+	size_t planAdaptivePass(const Mirror& mirror, uint32_t total, uint32_t per_pass);
+	void refineQueued(size_t begin, size_t end, const Viewport& view, uint32_t total, uint32_t per_pass);
+
+	// called by a task when it finishes, start is when it began
+	void recordTile(const SDL_Rect& rect, std::chrono::steady_clock::time_point start, uint64_t iterations);
+
+	void drawOverlay();
+	void drawTileOverlay();
+	uint32_t samplePixel(real_t px, real_t py, const Viewport& view, uint64_t& iterations) const;
+	uint32_t getColorTimed(uint64_t& ns, uint32_t iterated, real_t zx, real_t zy) const;
+
 public:
-	struct PixelInfo {
-		union {
-			struct {
-				uint32_t sample_count;
-				uint32_t acc_r;
-				uint32_t acc_g;
-				uint32_t acc_b;
-			};
-			bool rendered = false;
-		};
+	// the samples of a pixel summed per channel, their luminance keeps a running mean and
+	// variance (Welford)
+	struct SampleAccum {
+		uint32_t acc_r    = 0;
+		uint32_t acc_g    = 0;
+		uint32_t acc_b    = 0;
+		float    lum_mean = 0.f;
+		float    lum_m2   = 0.f;
+	};
+
+	// large pages for planes of 2 MB and more, taken from the next resize on. the OS may refuse
+	// them (Windows needs the lock pages privilege), the planes then use normal pages.
+	static inline bool getHugePages() { return huge_pages; }
+	static inline void setHugePages(bool val) { huge_pages = val; }
+
+	// 64-byte aligned storage for one value per pixel, or per word of the bitmap
+	template <class T>
+	struct Plane {
+		T*     data     = nullptr;
+		size_t count    = 0;
+		size_t capacity = 0;
+		bool   large    = false; // backed by large pages
+
+		void allocate(size_t count);
+		// count values, the storage only grows (by a quarter more than asked for). within the
+		// capacity the values are left as they were, growing reallocates and loses all of them:
+		// the new storage starts default constructed.
+		void resize(size_t count);
+		void free();
+
+		inline T& operator[](size_t i) { return data[i]; }
+		inline const T& operator[](size_t i) const { return data[i]; }
+		inline size_t getBytes() const { return capacity * sizeof(T); }
 	};
 
+	// what is known about every pixel, as planes. a single sample render only keeps the bitmap
+	// of rendered pixels, the sample count and accumulator planes are only allocated while
+	// samples add up (more than one per pixel, or a backend that always counts them).
+	// rows of the bitmap start on a new word, so threads on different rows never share one.
 	struct RenderInfo {
-		void resize(uint32_t width, uint32_t height);
-		void reset(PixelInfo info = {});
+		// the pixels both sizes share keep what is known about them, old pixel (x, y) is
+		// new pixel (x + ox, y + oy)
+		void resize(uint32_t width, uint32_t height, int ox = 0, int oy = 0);
+		// new planes start from the rendered bits and the colors in surface, as if those were
+		// the first sample of each pixel
+		void setSamplePlanes(bool enable, const SDL_Surface* surface);
+		void reset();
 		void move(int32_t rel_px, int32_t rel_py);
-		void fillRect(SDL_Rect* rect, PixelInfo info = {});
+		void fillRect(const SDL_Rect* rect); // back to not rendered
 		void destroy();
 
-		inline PixelInfo& at(uint32_t px, uint32_t py) {
-			return *(pixels + py * width + px);
-		};
+		size_t getBytes() const;
+		inline bool hasSamplePlanes() const { return sample_count.data != nullptr; }
+
+		inline std::atomic<uint64_t>* row(uint32_t py) { return bits.data + py * stride; }
+
+		inline bool rendered(uint32_t px, uint32_t py) const {
+			return bits[py * stride + px / 64].load(std::memory_order_relaxed) >> (px % 64) & 1;
+		}
+
+		// the pixels of word w of row py in [w_begin, w_end) that were not rendered yet, as a
+		// mask. they count as rendered from here on, the caller has to give them their sample.
+		inline uint64_t claim(uint32_t py, int word, int w_begin, int w_end) {
+			auto& bits = row(py)[word];
+			auto mask  = bitRange(SDL_max(w_begin - word * 64, 0), SDL_min(w_end - word * 64, 64));
+			auto todo  = mask & ~bits.load(std::memory_order_relaxed);
+			return todo ? todo & ~bits.fetch_or(todo, std::memory_order_relaxed) : 0;
+		}
+
+		inline uint32_t getSampleCount(uint32_t px, uint32_t py) const {
+			return hasSamplePlanes() ? sample_count[py * width + px] : rendered(px, py);
+		}
+
+		// the first sample of a claimed pixel, only the sample planes need to hear about it
+		inline void setFirstSample(uint32_t px, uint32_t py, uint32_t color) {
+			if (!hasSamplePlanes()) return;
+			sample_count[py * width + px] = 0;
+			accum[py * width + px]        = {};
+			addSample(px, py, color);
+		}
+
+		// the sample planes only
+		inline void addSample(uint32_t px, uint32_t py, uint32_t color) {
+			auto& count = sample_count[py * width + px];
+			auto& acc   = accum[py * width + px];
+
+			uint32_t r = (color >> 16) & 0xff, g = (color >> 8) & 0xff, b = color & 0xff;
+
+			acc.acc_r += r;
+			acc.acc_g += g;
+			acc.acc_b += b;
+			++count;
+
+			float lum     = (2 * r + 5 * g + b) / 8.f;
+			float delta   = lum - acc.lum_mean;
+			acc.lum_mean += delta / count;
+			acc.lum_m2   += delta * (lum - acc.lum_mean);
+		}
+
+		inline float getVariance(uint32_t px, uint32_t py) const {
+			auto count = sample_count[py * width + px];
+			return count > 1 ? accum[py * width + px].lum_m2 / (count - 1) : 0.f;
+		}
+
+		inline uint32_t getColor(uint32_t px, uint32_t py) const {
+			auto  count = sample_count[py * width + px];
+			auto& acc   = accum[py * width + px];
+			return 0xff000000 | (acc.acc_r / count) << 16 | (acc.acc_g / count) << 8 | (acc.acc_b / count);
+		}
+
+		Plane<std::atomic<uint64_t>> bits;         // 1 per rendered pixel, stride words a row
+		Plane<uint32_t>              sample_count; // optional, width * height
+		Plane<SampleAccum>           accum;        // optional, width * height
+		Plane<std::atomic<uint64_t>> bits_spare;   // where resize() lays out the next bitmap
+		Plane<uint64_t>              scratch;      // one row of the bitmap, for move()
 
-		PixelInfo* pixels;
-		uint32_t   width;
-		uint32_t   height;
+		uint32_t width  = 0;
+		uint32_t height = 0;
+		uint32_t stride = 0;
 	};
 
 protected:
@@ -104,14 +453,25 @@ protected:
 	RenderInfo   render_info;
 	SDL_Surface* surface_temp;
 	SDL_Surface* surface;
+	SDL_Surface* surface_overlay;
 	SDL_Texture* texture;
 
+	// the surfaces don't own their pixels, these planes do. like the texture they only grow,
+	// draw() shows the top left width x height of it.
+	Plane<uint32_t> pixels;
+	Plane<uint32_t> pixels_temp;
+	Plane<uint32_t> pixels_overlay;
+	int             texture_width;
+	int             texture_height;
+
+	bool preview;
+
 	int width;
 	int height;
 	real_t aspect;
 
-	real_t pos_x;
-	real_t pos_y;
+	pos_t  pos_x;
+	pos_t  pos_y;
 	real_t scale;
 	uint32_t iter;
 
@@ -119,9 +479,114 @@ protected:
 	real_t   color_scale;
 	bool     smooth;
 
-	std::future<void> future;
+	Precision precision;
+
+	uint32_t              sample_total;
+	uint32_t              sample_per_launch;
+	std::atomic<uint32_t> sample_count;
+	sampling::Sequence    sample_sequence;
+	uint32_t              sample_seed;
+
+	bool                  adaptive;
+	real_t                sample_tolerance;
+	uint32_t              sample_budget;
+	std::atomic<uint64_t> refined_samples;
+	std::atomic<uint64_t> iteration_count;
+
+	// (priority, pixel index) of the pixels refined by the current adaptive pass
+	std::vector<std::pair<float, uint32_t>> adaptive_queue;
+
+	Overlay overlay;
+
+	// the tasks record into tiles_next, which is swapped with tiles_last when the frame finishes
+	std::vector<TileCost> tiles_next;
+	std::vector<TileCost> tiles_last;
+	std::atomic<uint32_t> tiles_next_count;
+	uint32_t              tiles_last_count;
+	mutable std::mutex    tiles_lock;
+
+	// only every colorize_sample_rows-th row times its colors, the clock costs about as much as getColor()
+	static constexpr int colorize_sample_rows = 16;
+
+	FrameMetrics*         metrics;
+	std::atomic<uint64_t> pixels_computed;
+	std::atomic<uint64_t> pixels_mirrored;
+	std::atomic<uint64_t> colorize_ns;
+	PerfCounters::Total   perf_total;
+
+	NucleusFinder nucleus_finder;
+	bool          snap_pending;
+
+	// the image the zoom started from stays in surface_temp while it runs
+	struct ZoomAnimation {
+		bool     active  = false;
+		double   seconds;
+		double   elapsed = 0.; // summed frame times
+		real_t   from_scale;
+		real_t   to_scale;
+		pos_t    x, y; // kept under pixel (px, py)
+		real_t   px, py;
+		Viewport source;
+	};
+
+	ZoomAnimation zoom;
+
+	// a part of some view rendered ahead, along with what its colors depend on
+	struct PrefetchTile {
+		Viewport        view;
+		SDL_Rect        rect;   // in pixels of view, may lie outside of the window
+		Plane<uint32_t> pixels; // rect.w * rect.h
+		uint32_t        iter;
+		uint32_t        color_idx;
+		real_t          color_scale;
+		bool            smooth;
+		bool            ready     = false; // rendered in full
+		uint64_t        last_used = 0;
+	};
+
+	// two pan bands and two zoom steps
+	static constexpr size_t max_prefetch_tiles = 4;
+
+	struct PanStep {
+		std::chrono::steady_clock::time_point time;
+		int32_t rel_px, rel_py;
+	};
+
+	// the last wheel step, the next one is guessed to repeat it at the same pixel
+	struct ZoomStep {
+		real_t px     = 0.;
+		real_t py     = 0.;
+		real_t factor = 1.;
+	};
+
+	static constexpr size_t pan_history = 16;
+
+	bool                      prefetch;
+	size_t                    prefetch_budget;
+	std::vector<PrefetchTile> prefetch_tiles;
+	std::vector<size_t>       prefetch_queue;   // tiles in the order the worker renders them
+	bool                      prefetch_planned; // for the current view and parameters
+	bool                      prefetch_pending; // under worker_lock
+	std::atomic<bool>         prefetching;
+	uint64_t                  prefetch_clock;
+	std::atomic<uint64_t>     prefetch_rendered;
+	uint64_t                  prefetch_hits;
+	PanStep                   pan_steps[pan_history] = {};
+	size_t                    pan_next;
+	ZoomStep                  zoom_step;
+
+	// async renders run on one thread for the whole lifetime, started with the first of them,
+	// so a frame doesn't cost a thread creation. is_rendering only drops under worker_lock.
+	std::thread             worker;
+	std::mutex              worker_lock;
+	std::condition_variable worker_signal;
+	bool                    worker_pending;
+	bool                    worker_quit;
+
 	std::atomic<bool> is_rendering;
 	std::atomic<bool> stop_all;
 
+	static bool huge_pages;
+
 	bool updated;
 };
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "mandelbrot_bignum.h"
+
+#include <algorithm>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/partitioner.h>
+#include <oneapi/tbb/task.h>
+
+#include "trace.h"
+
+using namespace std;
+using namespace oneapi;
+
+MandelbrotBignum::MandelbrotBignum(int width, int height)
+	: MandelbrotTBB(width, height)
+{
+	tiles_done  = 0;
+	tiles_total = 0;
+	limbs       = selectLimbs(4. * scale / height);
+}
+
+MandelbrotBignum::MandelbrotBignum(SDL_Renderer* renderer)
+	: MandelbrotTBB(renderer)
+{
+	tiles_done  = 0;
+	tiles_total = 0;
+	limbs       = selectLimbs(4. * scale / height);
+}
+
+MandelbrotBignum::~MandelbrotBignum()
+{
+	stop();
+}
+
+float MandelbrotBignum::getProgress() const
+{
+	return tiles_total ? (float)tiles_done / tiles_total : 1.f;
+}
+
+int MandelbrotBignum::selectLimbs(real_t dy)
+{
+	// 4 integer bits, the pixel size and 32 guard bits, rounded up to an instantiated width
+	static const int widths[] = { 2, 3, 4, 6, 8, 12, 16 };
+
+	auto bits = 4 - (int)log2(dy) + 32;
+	for (int n : widths)
+		if (64 * n >= bits) return n;
+	return 16;
+}
+
+void MandelbrotBignum::drawSurface()
+{
+	auto view = getViewport();
+	limbs     = selectLimbs(view.dy);
+
+	tiles.clear();
+	for (int y = 0; y < height; y += tile_size)
+		for (int x = 0; x < width; x += tile_size)
+			tiles.push_back({ x, y, SDL_min(tile_size, width - x), SDL_min(tile_size, height - y) });
+
+	auto dist = [cx = width / 2, cy = height / 2](const SDL_Rect& r) {
+		int dx = r.x + r.w / 2 - cx, dy = r.y + r.h / 2 - cy;
+		return dx * dx + dy * dy;
+	};
+	sort(tiles.begin(), tiles.end(), [&](const SDL_Rect& a, const SDL_Rect& b) { return dist(a) < dist(b); });
+
+	tiles_done  = 0;
+	tiles_total = (uint32_t)tiles.size();
+
+	auto render_tiles = [&](const tbb::blocked_range<size_t>& r) {
+		for (size_t i = r.begin(); i < r.end(); ++i) {
+			if (stop_all) {
+				tbb::task::current_context()->cancel_group_execution();
+				return;
+			}
+
+			switch (limbs) {
+			case 2:  renderTile<2>(tiles[i], view);  break;
+			case 3:  renderTile<3>(tiles[i], view);  break;
+			case 4:  renderTile<4>(tiles[i], view);  break;
+			case 6:  renderTile<6>(tiles[i], view);  break;
+			case 8:  renderTile<8>(tiles[i], view);  break;
+			case 12: renderTile<12>(tiles[i], view); break;
+			default: renderTile<16>(tiles[i], view); break;
+			}
+
+			++tiles_done;
+		}
+	};
+
+	arena.execute([&] {
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, tiles.size(), 1), render_tiles, tbb::simple_partitioner());
+	});
+}
+
+template <int N>
+void MandelbrotBignum::renderTile(const SDL_Rect& tile, const Viewport& view)
+{
+	TRACE_SCOPE_XY("bignum tile", tile.x, tile.y);
+	PerfCounters::Scope counters(perf_total);
+	auto start = chrono::steady_clock::now();
+	uint64_t computed = 0, iterations = 0;
+
+	for (int h = tile.y; h < tile.y + tile.h; ++h) {
+		if (stop_all) break;
+
+		auto* row = (uint32_t*)surface->pixels + h * surface->w;
+		auto cy   = view.max_y - pos_t(view.dy * (h + 0.5));
+
+		for (int word = tile.x / 64; word * 64 < tile.x + tile.w; ++word) {
+			for (auto todo = render_info.claim(h, word, tile.x, tile.x + tile.w); todo; todo &= todo - 1) {
+				int w = word * 64 + countTrailingZeros(todo);
+
+				auto cx = view.min_x + pos_t(view.dx * (w + 0.5));
+
+				real_t zx, zy;
+				auto iterated = mandelbrot<N>(cx, cy, iter, zx, zy);
+				iterations   += iterated;
+
+				row[w] = getColor(iterated, zx, zy);
+				render_info.setFirstSample(w, h, row[w]);
+				++computed;
+			}
+		}
+	}
+
+	iteration_count += iterations;
+	pixels_computed += computed;
+	recordTile(tile, start, iterations);
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+
+#include "mandelbrot_tbb.h"
+
+// brute-force reference renderer: every pixel is iterated in fixed_t<N> with N picked from the
+// zoom depth, without symmetry or any other shortcut. slow by design, it is the ground truth the
+// fast paths are validated against. tiles are handed out center first and show up as they finish.
+class MandelbrotBignum : public MandelbrotTBB
+{
+public:
+	using real_t = Mandelbrot::real_t;
+
+	MandelbrotBignum(int width, int height);
+	MandelbrotBignum(SDL_Renderer* renderer);
+	~MandelbrotBignum() override;
+
+	inline int getLimbs() const { return limbs; }
+	float getProgress() const;
+
+	static constexpr int tile_size = 32;
+
+private:
+	void drawSurface() override;
+	// a preview would need the bignum arithmetic too, new pixels stay black until the full frame
+	void drawPreview() override {}
+	bool usesPrefetch() const override { return false; }
+
+	template <int N>
+	void renderTile(const SDL_Rect& tile, const Viewport& view);
+
+	static int selectLimbs(real_t dy);
+
+	std::vector<SDL_Rect> tiles;
+	std::atomic<uint32_t> tiles_done;
+	std::atomic<uint32_t> tiles_total;
+	int limbs;
+};
\ No newline at end of file
@@ -1,13 +1,14 @@
 #include "mandelbrot_cuda.h"
 
+#include <chrono>
 #include <cuda_runtime.h>
 #include <device_launch_parameters.h>
 #include "color.h"
 
 using namespace std;
 
-using real_t    = Mandelbrot::real_t;
-using PixelInfo = Mandelbrot::PixelInfo;
+using real_t      = Mandelbrot::real_t;
+using SampleAccum = Mandelbrot::SampleAccum;
 
 template <class T>
 __device__ inline uint32_t mandelbrot(T& cx, T& cy, uint32_t max_iter);
@@ -22,17 +23,6 @@ __device__ inline void acc_color(uint32_t col, uint32_t& r, uint32_t& g, uint32_
 	b += color.b;
 }
 
-static __device__ __forceinline__ uint32_t lcg(uint32_t& prev)
-{
-	prev = (1664525u * prev + 1013904223u);
-	return prev & 0x00FFFFFF;
-}
-
-static __device__ __forceinline__ float rnd(uint32_t& prev)
-{
-	return ((float)lcg(prev) / (float)0x01000000);
-}
-
 struct Constants {
 	int      width;
 	int      height;
@@ -42,6 +32,9 @@ struct Constants {
 	real_t   color_scale;
 	bool     color_smooth;
 
+	sampling::Sequence sequence;
+	uint32_t           seed;
+
 	bool     stop_all;
 };
 
@@ -56,8 +49,9 @@ __device__ uint32_t get_color_idx(T iter) {
 }
 
 __global__ void mandelbrot_kernel(
-	uint32_t* device_surface,
-	PixelInfo* device_pixel_info,
+	uint32_t*    device_surface,
+	uint32_t*    device_sample_count,
+	SampleAccum* device_accum,
 	uint32_t   sample_total,
 	uint32_t   sample,
 	real_t     min_x,
@@ -71,13 +65,13 @@ __global__ void mandelbrot_kernel(
 
 	if (params.width <= w || params.height <= h) return;
 
-	auto pixel_off  = h * params.width + w;
-	auto& info      = *(device_pixel_info + pixel_off);
+	auto pixel_off     = h * params.width + w;
+	auto& sample_count = *(device_sample_count + pixel_off);
+	auto& info         = *(device_accum + pixel_off);
+
+	if (sample_count >= sample_total) return;
 
-	if (info.sample_count >= sample_total) return;
- 
-	auto seed  = (uint32_t)clock();
-	auto count = min(sample_total - info.sample_count, sample);
+	auto count = min(sample_total - sample_count, sample);
 
 	uint32_t col;
 	uint32_t r = info.acc_r;
@@ -87,8 +81,11 @@ __global__ void mandelbrot_kernel(
 	for (uint32_t i = 0; i < count; ++i) {
 		if (params.stop_all) return;
 		
-		real_t cx = min_x + dp * (w + rnd(seed));
-		real_t cy = max_y - dp * (h + rnd(seed));
+		float x, y;
+		sampling::sample2D(params.sequence, pixel_off, sample_count + i, params.seed, x, y);
+
+		real_t cx = min_x + dp * (w + x);
+		real_t cy = max_y - dp * (h + y);
 
 		auto iterated = mandelbrot<real_t>(cx, cy, params.iter);
 
@@ -110,13 +107,13 @@ __global__ void mandelbrot_kernel(
 		acc_color(col, r, g, b);
 	}
 
-	info.sample_count += count;
-	info.acc_r         = r;
-	info.acc_g         = g;
-	info.acc_b         = b;
+	sample_count += count;
+	info.acc_r    = r;
+	info.acc_g    = g;
+	info.acc_b    = b;
 
 	auto& pixel = *(device_surface + pixel_off);
-	pixel = make_color(r / info.sample_count, g / info.sample_count, b / info.sample_count);
+	pixel = make_color(r / sample_count, g / sample_count, b / sample_count);
 }
 
 MandelbrotCUDA::MandelbrotCUDA(SDL_Renderer* renderer) 
@@ -124,58 +121,63 @@ MandelbrotCUDA::MandelbrotCUDA(SDL_Renderer* renderer)
 {
 	size_t size = surface->w * surface->h;
 
+	render_info.setSamplePlanes(true, surface);
+
 	cudaHostRegister(surface->pixels, size * sizeof(uint32_t), cudaHostRegisterDefault);
-	cudaHostRegister(render_info.pixels, size * sizeof(PixelInfo), cudaHostRegisterDefault);
+	cudaHostRegister(render_info.sample_count.data, size * sizeof(uint32_t), cudaHostRegisterDefault);
+	cudaHostRegister(render_info.accum.data, size * sizeof(SampleAccum), cudaHostRegisterDefault);
 
 	cudaMalloc((void**)&device_surface, size * sizeof(uint32_t));
-	cudaMalloc((void**)&device_pixel_info, size * sizeof(PixelInfo));
+	cudaMalloc((void**)&device_sample_count, size * sizeof(uint32_t));
+	cudaMalloc((void**)&device_accum, size * sizeof(SampleAccum));
+	device_capacity = size;
 
 	cudaMemcpyToSymbol(cuda_colormap, colormap, sizeof(colormap));
 
 	cudaStreamCreate(&streams[0]);
 	cudaStreamCreate(&streams[1]);
 
-	block_size        = 8;
-	sample_total      = 1;
-	sample_per_launch = 1;
-	sample_count      = 0;
+	block_size = 8;
 
 	update();
 }
 
 MandelbrotCUDA::~MandelbrotCUDA()
 {
+	stop();
 	cudaHostUnregister(surface->pixels);
-	cudaHostUnregister(render_info.pixels);
+	cudaHostUnregister(render_info.sample_count.data);
+	cudaHostUnregister(render_info.accum.data);
 	cudaFree(device_surface);
-	cudaFree(device_pixel_info);
+	cudaFree(device_sample_count);
+	cudaFree(device_accum);
 	cudaStreamDestroy(streams[0]);
 	cudaStreamDestroy(streams[1]);
 }
 
-void MandelbrotCUDA::setTotalSample(uint32_t sample)
-{
-	auto clear = sample_count > (sample_total = sample);
-	update(clear, clear);
-}
-
 void MandelbrotCUDA::draw()
 {
 	size_t size = surface->w * surface->h * sizeof(uint32_t);
 
-	cudaMemcpyAsync(surface->pixels, device_surface, size, cudaMemcpyDeviceToHost, streams[0]);
-	cudaStreamSynchronize(streams[0]);
+	// a zoom animation draws its frames on the host, the device still has the old view
+	if (!isAnimating()) {
+		cudaMemcpyAsync(surface->pixels, device_surface, size, cudaMemcpyDeviceToHost, streams[0]);
+		cudaStreamSynchronize(streams[0]);
+	}
 	Mandelbrot::draw();
 }
 
 void MandelbrotCUDA::stop()
 {
 	if (is_rendering) {
+		auto   start  = chrono::steady_clock::now();
 		size_t offset = offsetof(Constants, stop_all);
 
 		cudaMemcpyToSymbolAsync(params, &is_rendering, 1, offset, cudaMemcpyHostToDevice, streams[0]);
 		wait();
 		cudaMemcpyToSymbolAsync(params, &is_rendering, 1, offset, cudaMemcpyHostToDevice, streams[0]);
+
+		if (metrics) metrics->addCancel(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
 	}
 }
 
@@ -184,27 +186,39 @@ void MandelbrotCUDA::wait()
 	cudaStreamSynchronize(streams[1]);
 }
 
-void MandelbrotCUDA::resize()
+// the base class keeps the pixels both sizes share on the host side, they go back up after
+void MandelbrotCUDA::resize(int width, int height)
 {
-	int width, height;
-	SDL_GetWindowSize(window, &width, &height);
-	
-	size_t size = width * height;
-
 	stop();
-	cudaFree(device_surface);
-	cudaFree(device_pixel_info);
 
-	cudaMalloc((void**)&device_surface, size * sizeof(uint32_t));
-	cudaMalloc((void**)&device_pixel_info, size * sizeof(PixelInfo));
-	
+	size_t size = surface->w * surface->h;
+	cudaMemcpy(surface->pixels, device_surface, size * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+
 	cudaHostUnregister(surface->pixels);
-	cudaHostUnregister(render_info.pixels);
+	cudaHostUnregister(render_info.sample_count.data);
+	cudaHostUnregister(render_info.accum.data);
 
-	Mandelbrot::resize();
+	Mandelbrot::resize(width, height);
+	size = (size_t)width * height;
+
+	if (size > device_capacity) {
+		cudaFree(device_surface);
+		cudaFree(device_sample_count);
+		cudaFree(device_accum);
+
+		device_capacity = size + size / 4;
+		cudaMalloc((void**)&device_surface, device_capacity * sizeof(uint32_t));
+		cudaMalloc((void**)&device_sample_count, device_capacity * sizeof(uint32_t));
+		cudaMalloc((void**)&device_accum, device_capacity * sizeof(SampleAccum));
+	}
 
 	cudaHostRegister(surface->pixels, size * sizeof(uint32_t), cudaHostRegisterDefault);
-	cudaHostRegister(render_info.pixels, size * sizeof(PixelInfo), cudaHostRegisterDefault);
+	cudaHostRegister(render_info.sample_count.data, size * sizeof(uint32_t), cudaHostRegisterDefault);
+	cudaHostRegister(render_info.accum.data, size * sizeof(SampleAccum), cudaHostRegisterDefault);
+
+	cudaMemcpy(device_surface, surface->pixels, size * sizeof(uint32_t), cudaMemcpyHostToDevice);
+	cudaMemcpy(device_sample_count, render_info.sample_count.data, size * sizeof(uint32_t), cudaMemcpyHostToDevice);
+	cudaMemcpy(device_accum, render_info.accum.data, size * sizeof(SampleAccum), cudaMemcpyHostToDevice);
 }
 
 void MandelbrotCUDA::move(int32_t rel_px, int32_t rel_py)
@@ -214,12 +228,14 @@ void MandelbrotCUDA::move(int32_t rel_px, int32_t rel_py)
 	size_t size = surface->w * surface->h;
 
 	cudaMemcpy(surface->pixels, device_surface, size * sizeof(uint32_t), cudaMemcpyDeviceToHost);
-	cudaMemcpy(render_info.pixels, device_pixel_info, size * sizeof(PixelInfo), cudaMemcpyDeviceToHost);
+	cudaMemcpy(render_info.sample_count.data, device_sample_count, size * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+	cudaMemcpy(render_info.accum.data, device_accum, size * sizeof(SampleAccum), cudaMemcpyDeviceToHost);
 
 	Mandelbrot::move(rel_px, rel_py);
 	
 	cudaMemcpy(device_surface, surface->pixels, size * sizeof(uint32_t), cudaMemcpyHostToDevice);
-	cudaMemcpy(device_pixel_info, render_info.pixels, size * sizeof(PixelInfo), cudaMemcpyHostToDevice);
+	cudaMemcpy(device_sample_count, render_info.sample_count.data, size * sizeof(uint32_t), cudaMemcpyHostToDevice);
+	cudaMemcpy(device_accum, render_info.accum.data, size * sizeof(SampleAccum), cudaMemcpyHostToDevice);
 }
 
 void MandelbrotCUDA::drawSurface()
@@ -227,21 +243,23 @@ void MandelbrotCUDA::drawSurface()
 	dim3 grid((width - 1) / block_size + 1, (height - 1) / block_size + 1);
 	dim3 block(block_size, block_size);
 
-	real_t min_x = pos_x - 2. * scale * aspect;
-	real_t max_y = pos_y + 2. * scale;
-	real_t dp    = 4. * scale / height;
+	auto   view  = getViewport();
+	real_t min_x = (real_t)view.min_x;
+	real_t max_y = (real_t)view.max_y;
+	real_t dp    = view.dy;
 
 	while (sample_count < sample_total) {
 		if (stop_all) break;
 
 		mandelbrot_kernel<<<grid, block, 0, streams[1]>>> (
 			device_surface,
-			device_pixel_info,
+			device_sample_count,
+			device_accum,
 			sample_total,
 			sample_per_launch,
 			min_x, max_y, dp);
 
-		sample_count = min(sample_count + sample_per_launch, sample_total);
+		sample_count = min<uint32_t>(sample_count + sample_per_launch, sample_total);
 		cudaStreamSynchronize(streams[1]);
 	}
 
@@ -252,17 +270,17 @@ void MandelbrotCUDA::update(bool rerender_all, bool clear_surface)
 {
 	Mandelbrot::update(rerender_all, clear_surface);
 	
-	sample_count = 0;
-	
 	size_t size = surface->w * surface->h;
 
-	if (rerender_all)
-		cudaMemset(device_pixel_info, 0, size * sizeof(PixelInfo));
+	if (rerender_all) {
+		cudaMemset(device_sample_count, 0, size * sizeof(uint32_t));
+		cudaMemset(device_accum, 0, size * sizeof(SampleAccum));
+	}
 	if (clear_surface)
 		cudaMemset(device_surface, 0, size * sizeof(uint32_t));
 
 	Constants constants = {
-		width, height, iter, color_idx,color_scale, smooth, stop_all
+		width, height, iter, color_idx,color_scale, smooth, sample_sequence, sample_seed, stop_all
 	};
 
 	cudaMemcpyToSymbol(params, &constants, sizeof(Constants));
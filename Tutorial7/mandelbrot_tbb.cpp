@@ -1,14 +1,24 @@
 #include "mandelbrot_tbb.h"
 
 #include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/blocked_range.h>
 #include <oneapi/tbb/blocked_range2d.h>
 #include <oneapi/tbb/task.h>
 
-#include "color.h"
+#include <chrono>
+#include <thread>
+
+#include "trace.h"
 
 using namespace std;
 using namespace oneapi;
 
+MandelbrotTBB::MandelbrotTBB(int width, int height)
+	: Mandelbrot(width, height)
+{
+	arena.initialize();
+}
+
 MandelbrotTBB::MandelbrotTBB(SDL_Renderer* renderer)
 	: Mandelbrot(renderer) 
 {
@@ -17,7 +27,9 @@ MandelbrotTBB::MandelbrotTBB(SDL_Renderer* renderer)
 
 MandelbrotTBB::~MandelbrotTBB()
 {
+	stop();
 	arena.terminate();
+	tune_arena.terminate();
 }
 
 uint32_t MandelbrotTBB::getMaxConcurrency() const
@@ -33,63 +45,238 @@ void MandelbrotTBB::setMaxConcurrency(uint32_t val)
 	update(false, false);
 }
 
-void MandelbrotTBB::startAsync() {
-	promise<void> p;
-	future = p.get_future();
+void MandelbrotTBB::setGrainSize(uint32_t val)
+{
+	stop();
+	grain = SDL_max(val, 1u);
+	update(false, false);
+}
+
+void MandelbrotTBB::setPartitioner(Partitioner val)
+{
+	stop();
+	partitioner = val;
+	update(false, false);
+}
 
-	arena.enqueue([this, p = std::move(p)]() {
-		is_rendering = true;
-		drawSurface();
-		is_rendering = false;
+void MandelbrotTBB::setAutotune(bool val)
+{
+	stop();
+	autotune = val;
 
-		const_cast<promise<void>&>(p).set_value();
-	});
+	// a fresh start from the manual settings, throughput measured on earlier views means little
+	tune_arms     = { { (uint32_t)arena.max_concurrency(), grain } };
+	tune_best     = 0;
+	tune_current  = 0;
+	tune_frames   = 0;
+	tune_explored = 0;
+	tuned_threads = tune_arms[0].threads;
+	tuned_grain   = tune_arms[0].grain;
+
+	update(false, false);
+}
+
+void MandelbrotTBB::setExploreBudget(float val)
+{
+	explore_budget = SDL_clamp(val, 0.f, 1.f);
+}
+
+static constexpr uint32_t max_tuned_grain = 256;
+
+const MandelbrotTBB::TuneArm& MandelbrotTBB::tuneFrame()
+{
+	tune_current = tune_best;
+	++tune_frames;
+
+	// explore only while it stays within budget, the other frames render with the best arm
+	if (tune_explored + 1 <= explore_budget * tune_frames) {
+		auto hardware = max(thread::hardware_concurrency(), 1u);
+		auto step     = max(hardware / 8, 1u);
+		auto best     = tune_arms[tune_best];
+
+		// neighbours in turn: fewer threads, more threads, finer grain, coarser grain. threads move
+		// by an eighth of the machine, grain by powers of two
+		for (int tries = 0; tries < 4; ++tries) {
+			auto arm = best;
+			switch (tune_neighbour++ % 4) {
+			case 0: arm.threads = best.threads > step ? best.threads - step : 1; break;
+			case 1: arm.threads = min(best.threads + step, hardware); break;
+			case 2: arm.grain   = max(best.grain / 2, 1u); break;
+			case 3: arm.grain   = min(best.grain * 2, max_tuned_grain); break;
+			}
+			if (arm.threads == best.threads && arm.grain == best.grain) continue;
+
+			auto it = find_if(tune_arms.begin(), tune_arms.end(),
+				[&](const TuneArm& a) { return a.threads == arm.threads && a.grain == arm.grain; });
+			if (it == tune_arms.end()) {
+				arm.throughput = 0.;
+				it = tune_arms.insert(it, arm);
+			}
+
+			tune_current = it - tune_arms.begin();
+			++tune_explored;
+			break;
+		}
+	}
+
+	auto& arm = tune_arms[tune_current];
+	if (!tune_arena.is_active() || tune_arena.max_concurrency() != (int)arm.threads) {
+		tune_arena.terminate();
+		tune_arena.initialize(arm.threads);
+	}
+	return arm;
+}
+
+void MandelbrotTBB::reportFrame(double seconds, uint64_t iterations)
+{
+	// tiny frames, like the strip uncovered by a small move, are mostly overhead and timer noise
+	if (seconds < 2e-3 || iterations < 100000) return;
+
+	auto& arm  = tune_arms[tune_current];
+	double now = iterations / seconds;
+
+	// the view drifts, an arm not measured for a while starts over from this frame
+	bool stale     = arm.last_frame + 32 < tune_frames || arm.throughput == 0.;
+	arm.throughput = stale ? now : arm.throughput + .25 * (now - arm.throughput);
+	arm.last_frame = tune_frames;
+
+	// hill climb, the margin keeps frame to frame noise from moving the best around
+	if (tune_current != tune_best && arm.throughput > 1.05 * tune_arms[tune_best].throughput) {
+		tune_best     = tune_current;
+		tuned_threads = arm.threads;
+		tuned_grain   = arm.grain;
+	}
+}
+
+template <class Range, class Body>
+void MandelbrotTBB::parallelFor(const Range& range, const Body& body)
+{
+	switch (partitioner) {
+	case Partitioner::Simple:   tbb::parallel_for(range, body, tbb::simple_partitioner()); break;
+	case Partitioner::Static:   tbb::parallel_for(range, body, tbb::static_partitioner()); break;
+	case Partitioner::Affinity: tbb::parallel_for(range, body, affinity); break;
+	default:                    tbb::parallel_for(range, body, tbb::auto_partitioner());
+	}
 }
 
 void MandelbrotTBB::drawSurface()
 {
 	using range_t = tbb::blocked_range2d<int, int>;
 
-	real_t min_x   = pos_x - 2. * scale * aspect;
-	real_t max_y   = pos_y + 2. * scale;
-	real_t dx      = 4. * scale * aspect / width;
-	real_t dy      = 4. * scale / height;
+	auto view     = getViewport();
+	auto mirror   = getMirror();
+	auto total    = sample_total;
+	auto per_pass = sample_per_launch;
 
-	tbb::parallel_for(range_t(0, height, 0, width), [=](range_t& r) {
-		for (int h = r.rows().begin(); h < r.rows().end(); ++h) {
-			if (stop_all) {
-				tbb::task::current_context()->cancel_group_execution();
-				return;
-			}
+	auto  frame_grain = grain;
+	auto* frame_arena = &arena;
+	if (autotune) {
+		auto& arm   = tuneFrame();
+		frame_grain = arm.grain;
+		frame_arena = &tune_arena;
+	}
+
+	// copies the rows the other half of the image has, after every pass
+	auto mirror_band = [&] {
+		if (stop_all) return false;
+
+		tbb::parallel_for(tbb::blocked_range<int>(mirror.begin, mirror.end), [&](const tbb::blocked_range<int>& r) {
+			TRACE_SCOPE_XY("mirror", 0, r.begin());
+			PerfCounters::Scope counters(perf_total);
+			for (int h = r.begin(); h < r.end(); ++h)
+				mirrorRow(h, mirror);
+		});
+		return true;
+	};
 
-			for (int w = r.cols().begin(); w < r.cols().end(); ++w) {
-				auto& info = render_info.at(w, h);
-				if (info.rendered) continue;
-
-				uint32_t& pixel = *((uint32_t*)surface->pixels + h * surface->w + w);
-
-				real_t cx = min_x + dx * (w + 0.5f);
-				real_t cy = max_y - dy * (h + 0.5f);
-
-				auto iterated = mandelbrot<real_t>(cx, cy, iter);
-
-				if (iterated == iter) {
-					pixel = 0xff000000;
-				} else if (!smooth) {
-					pixel = colormap[color_idx][(int)(color_scale * 256 * iterated / iter) % 256];
-				}  else {
-					double log_zn  = log(cx * cx + cy * cy) / 2.;
-					double nu      = log(log_zn / log(2)) / log(2);
-					auto real_iter = iterated + 3.5 - nu;
-							
-					auto col1 = colormap[color_idx][(int)(color_scale * 256 * real_iter / iter) % 256];
-					auto col2 = colormap[color_idx][(int)(color_scale * 256 * (real_iter + 1) / iter) % 256];
-							
-					pixel = lerp_color(col1, col2, fmod(iter, 1));
+	// span returns the iterations it spent, the tiles of the first pass record their cost
+	auto pass = [&](auto&& span, bool record) {
+		parallelFor(range_t(0, height, frame_grain, 0, width, frame_grain), [&](const range_t& r) {
+			TRACE_SCOPE_XY("tile", r.cols().begin(), r.rows().begin());
+			PerfCounters::Scope counters(perf_total);
+			auto start = chrono::steady_clock::now();
+			uint64_t iterations = 0;
+
+			for (int h = r.rows().begin(); h < r.rows().end(); ++h) {
+				if (stop_all) {
+					tbb::task::current_context()->cancel_group_execution();
+					return;
 				}
+				if (mirror.contains(h)) continue;
 
-				info.rendered = true;
+				iterations += span(h, r.cols().begin(), r.cols().end());
 			}
+
+			if (record) {
+				SDL_Rect rect = { r.cols().begin(), r.rows().begin(), (int)r.cols().size(), (int)r.rows().size() };
+				recordTile(rect, start, iterations);
+			}
+		});
+
+		return mirror_band();
+	};
+
+	auto start      = chrono::steady_clock::now();
+	auto iterations = iteration_count.load();
+
+	// the frame runs on the caller's thread, or the async worker's, the arena keeps it to max
+	// concurrency. while tuning, it moves into the tuning arena instead.
+	frame_arena->execute([&] {
+		if (!pass([&](int h, int w_begin, int w_end) { return renderSpan(h, w_begin, w_end, view); }, true)) return;
+
+		if (adaptive) {
+			for (sample_count = 1; auto queued = planAdaptivePass(mirror, total, per_pass); ++sample_count) {
+				tbb::parallel_for(tbb::blocked_range<size_t>(0, queued), [&](const tbb::blocked_range<size_t>& r) {
+					TRACE_SCOPE("refine");
+					PerfCounters::Scope counters(perf_total);
+					refineQueued(r.begin(), r.end(), view, total, per_pass);
+				});
+				if (!mirror_band()) return;
+			}
+			return;
 		}
+
+		for (sample_count = 1; sample_count < total; sample_count = min(sample_count + per_pass, total))
+			if (!pass([&](int h, int w_begin, int w_end) { sampleSpan(h, w_begin, w_end, view, total, per_pass); return uint64_t(0); }, false)) return;
 	});
-}
\ No newline at end of file
+
+	if (autotune && !stop_all) {
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+		reportFrame(elapsed.count(), iteration_count - iterations);
+	}
+}
+
+// rows of blocks split evenly, at a sixteenth of the samples the tuned settings don't matter
+void MandelbrotTBB::drawPreview()
+{
+	auto view = getViewport();
+	int  rows = (height + preview_block - 1) / preview_block;
+
+	arena.execute([&] {
+		tbb::parallel_for(tbb::blocked_range<int>(0, rows), [&](const tbb::blocked_range<int>& r) {
+			uint64_t iterations = 0;
+			for (int i = r.begin(); i < r.end(); ++i) {
+				if (stop_all) break;
+				iterations += previewRow(i * preview_block, view);
+			}
+			iteration_count += iterations;
+		});
+	});
+}
+
+// in the frames' arena, so the prefetch keeps to the same concurrency
+void MandelbrotTBB::drawPrefetch(PrefetchTile& tile)
+{
+	arena.execute([&] {
+		tbb::parallel_for(tbb::blocked_range<int>(0, tile.rect.h), [&](const tbb::blocked_range<int>& r) {
+			TRACE_SCOPE_XY("prefetch rows", tile.rect.x, tile.rect.y + r.begin());
+			for (int y = r.begin(); y < r.end(); ++y) {
+				if (stop_all) {
+					tbb::task::current_context()->cancel_group_execution();
+					return;
+				}
+				prefetchRow(tile, y);
+			}
+		});
+	});
+}
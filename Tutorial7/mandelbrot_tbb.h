@@ -1,6 +1,9 @@
 #pragma once
 
+#include <vector>
+#include <atomic>
 #include <oneapi/tbb/task_arena.h>
+#include <oneapi/tbb/partitioner.h>
 
 #include "mandelbrot.h"
 
@@ -9,15 +12,78 @@ class MandelbrotTBB : public Mandelbrot
 public:
 	using real_t = Mandelbrot::real_t;
 
+	// how parallel_for splits the image, see the TBB partitioner docs
+	enum class Partitioner {
+		Auto     = 0,
+		Simple   = 1,
+		Static   = 2,
+		Affinity = 3 // replays the previous render's tile to thread mapping
+	};
+
+	MandelbrotTBB(int width, int height);
 	MandelbrotTBB(SDL_Renderer* renderer);
 	~MandelbrotTBB() override;
 
 	uint32_t getMaxConcurrency() const;
 	void setMaxConcurrency(uint32_t val);
 
+	// smallest block of rows and columns a task is split down to, 1 is TBB's default
+	inline uint32_t getGrainSize() const { return grain; }
+	void setGrainSize(uint32_t val);
+
+	inline Partitioner getPartitioner() const { return partitioner; }
+	void setPartitioner(Partitioner val);
+
+	// online tuning: some frames try a concurrency or grain next to the current best one, the
+	// best moves to whichever renders the most iterations per second. starts from the manual settings.
+	inline bool getAutotune() const { return autotune; }
+	void setAutotune(bool val);
+
+	// largest fraction of the frames spent trying other settings
+	inline float getExploreBudget() const { return explore_budget; }
+	void setExploreBudget(float val);
+
+	inline uint32_t getTunedConcurrency() const { return tuned_threads; }
+	inline uint32_t getTunedGrainSize() const { return tuned_grain; }
+	inline uint32_t getTunedFrames() const { return tune_frames; }
+	inline uint32_t getExploredFrames() const { return tune_explored; }
+
 private:
-	void startAsync() override;
 	void drawSurface() override;
+	void drawPreview() override;
+	void drawPrefetch(PrefetchTile& tile) override;
+
+	template <class Range, class Body>
+	void parallelFor(const Range& range, const Body& body);
+
+	struct TuneArm {
+		uint32_t threads;
+		uint32_t grain;
+		double   throughput = 0.; // iterations per second, moving average
+		uint32_t last_frame = 0;
+	};
+
+	const TuneArm& tuneFrame();
+	void reportFrame(double seconds, uint64_t iterations);
+
+	uint32_t    grain       = 1;
+	Partitioner partitioner = Partitioner::Auto;
+
+	oneapi::tbb::affinity_partitioner affinity;
+
+	bool                  autotune       = false;
+	float                 explore_budget = 0.1f;
+	std::vector<TuneArm>  tune_arms;
+	size_t                tune_best      = 0;
+	size_t                tune_current   = 0;
+	uint32_t              tune_neighbour = 0;
+	std::atomic<uint32_t> tune_frames   = 0;
+	std::atomic<uint32_t> tune_explored = 0;
+	std::atomic<uint32_t> tuned_threads = 0;
+	std::atomic<uint32_t> tuned_grain   = 0;
+
+	oneapi::tbb::task_arena tune_arena; // the frame runs here while tuning, sized to the arm being tried
 
+protected:
 	oneapi::tbb::task_arena arena;
 };
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "metrics.h"
+
+#include <algorithm>
+
+using namespace std;
+
+template <class T>
+static void pushRing(vector<T>& ring, size_t& next, const T& value, size_t capacity)
+{
+	if (ring.size() < capacity) ring.push_back(value);
+	else ring[next] = value;
+	next = (next + 1) % capacity;
+}
+
+template <class T>
+static void unrollRing(const vector<T>& ring, size_t next, vector<T>& result)
+{
+	result.clear();
+	if (ring.size() < FrameMetrics::window) {
+		result.insert(result.end(), ring.begin(), ring.end());
+		return;
+	}
+
+	result.insert(result.end(), ring.begin() + next, ring.end());
+	result.insert(result.end(), ring.begin(), ring.begin() + next);
+}
+
+// the rings and the scratch space are allocated once, adding frames doesn't allocate
+FrameMetrics::FrameMetrics()
+{
+	frames.reserve(window);
+	uploads.reserve(window);
+	sorted.reserve(window);
+}
+
+void FrameMetrics::addFrame(FrameStats frame)
+{
+	lock_guard<std::mutex> guard(lock);
+
+	frame.upload_ms = last_upload;
+	pushRing(frames, next_frame, frame, window);
+	++frame_count;
+
+	if (csv.is_open()) {
+		csv << frame_count << "," << frame.render_ms << "," << frame.colorize_ms << "," << frame.upload_ms << ","
+		    << frame.pixels_computed << "," << frame.pixels_mirrored << "," << frame.pixels_reused << ","
+		    << frame.iterations << "," << frame.getIterationsPerSecond() << "," << cancel_count << ","
+		    << cancel_latency << "," << frame.perf.cycles << "," << frame.perf.instructions << ","
+		    << frame.perf.getIPC() << "," << frame.perf.branch_misses << "," << frame.perf.cache_misses << "\n";
+	}
+}
+
+void FrameMetrics::addUpload(double ms)
+{
+	lock_guard<std::mutex> guard(lock);
+
+	last_upload = ms;
+	pushRing(uploads, next_upload, (float)ms, window);
+}
+
+void FrameMetrics::addCancel(double latency_ms)
+{
+	lock_guard<std::mutex> guard(lock);
+
+	++cancel_count;
+	cancel_latency = latency_ms;
+}
+
+void FrameMetrics::reset()
+{
+	lock_guard<std::mutex> guard(lock);
+
+	frames.clear();
+	uploads.clear();
+	next_frame     = 0;
+	next_upload    = 0;
+	frame_count    = 0;
+	cancel_count   = 0;
+	cancel_latency = 0.;
+}
+
+void FrameMetrics::getFrames(vector<FrameStats>& frames) const
+{
+	lock_guard<std::mutex> guard(lock);
+	unrollRing(this->frames, next_frame, frames);
+}
+
+void FrameMetrics::getUploads(vector<float>& uploads) const
+{
+	lock_guard<std::mutex> guard(lock);
+	unrollRing(this->uploads, next_upload, uploads);
+}
+
+FrameStats FrameMetrics::getLastFrame() const
+{
+	lock_guard<std::mutex> guard(lock);
+	if (frames.empty()) return {};
+	return frames[(next_frame + window - 1) % window];
+}
+
+double FrameMetrics::getPercentile(double p) const
+{
+	lock_guard<std::mutex> guard(lock);
+	if (frames.empty()) return 0.;
+
+	sorted.clear();
+	for (auto& frame : frames) sorted.push_back(frame.render_ms);
+
+	// nearest rank
+	auto rank = min((size_t)(p * sorted.size()), sorted.size() - 1);
+	nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+uint32_t FrameMetrics::getCancelCount() const
+{
+	lock_guard<std::mutex> guard(lock);
+	return cancel_count;
+}
+
+double FrameMetrics::getCancelLatency() const
+{
+	lock_guard<std::mutex> guard(lock);
+	return cancel_latency;
+}
+
+bool FrameMetrics::startCSV(const string& path)
+{
+	lock_guard<std::mutex> guard(lock);
+
+	ifstream existing(path, ios::binary | ios::ate);
+	bool empty = !existing || existing.tellg() <= 0;
+	existing.close();
+
+	csv.close();
+	csv.open(path, ios::app);
+	if (!csv) return false;
+
+	if (empty) {
+		csv << "frame,render_ms,colorize_ms,upload_ms,pixels_computed,pixels_mirrored,pixels_reused,"
+		       "iterations,iterations_per_s,cancels,cancel_latency_ms,cycles,instructions,ipc,branch_misses,"
+		       "cache_misses\n";
+	}
+	return true;
+}
+
+void FrameMetrics::stopCSV()
+{
+	lock_guard<std::mutex> guard(lock);
+	csv.close();
+}
+
+bool FrameMetrics::isRecording() const
+{
+	lock_guard<std::mutex> guard(lock);
+	return csv.is_open();
+}
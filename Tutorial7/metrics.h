@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <fstream>
+
+#include "perf_counters.h"
+
+// what one finished render cost, filled in by the backend that rendered it
+struct FrameStats
+{
+	double   render_ms       = 0.; // drawSurface() wall time
+	double   colorize_ms     = 0.; // estimated from the rows that time their getColor() calls
+	double   upload_ms       = 0.; // most recent texture upload when the frame finished
+	uint64_t pixels_computed = 0;  // iterated for the first time in this frame
+	uint64_t pixels_mirrored = 0;  // copied from the other half of the image
+	uint64_t pixels_reused   = 0;  // left over from the previous frame, e.g. after a move
+	uint64_t iterations      = 0;
+	PerfSample perf;               // summed over the worker threads, empty without counters
+
+	double getIterationsPerSecond() const { return render_ms > 0. ? iterations / render_ms * 1e3 : 0.; }
+};
+
+// rolling window over the last frames, written from the render threads and read by the GUI.
+// every frame can also be appended to a CSV file for offline comparison.
+class FrameMetrics
+{
+public:
+	static constexpr size_t window = 240;
+
+	FrameMetrics();
+
+	void addFrame(FrameStats frame);
+	void addUpload(double ms);
+	void addCancel(double latency_ms);
+	void reset();
+
+	// oldest first, into the storage the vectors already have
+	void getFrames(std::vector<FrameStats>& frames) const;
+	void getUploads(std::vector<float>& uploads) const;
+	FrameStats getLastFrame() const;
+
+	// of the render times in the window, p in [0, 1]
+	double getPercentile(double p) const;
+
+	uint32_t getCancelCount() const;
+	double getCancelLatency() const; // of the last cancel, in ms
+
+	// appends to the file, the header goes in only when it is empty
+	bool startCSV(const std::string& path);
+	void stopCSV();
+	bool isRecording() const;
+
+private:
+	mutable std::mutex lock;
+
+	std::vector<FrameStats> frames; // ring buffers of up to window entries
+	std::vector<float>      uploads;
+	mutable std::vector<double> sorted; // for the percentiles
+	size_t   next_frame     = 0;
+	size_t   next_upload    = 0;
+	uint64_t frame_count    = 0;
+	uint32_t cancel_count   = 0;
+	double   cancel_latency = 0.;
+	double   last_upload    = 0.;
+
+	std::ofstream csv;
+};
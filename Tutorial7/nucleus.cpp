@@ -0,0 +1,230 @@
+#include "nucleus.h"
+
+#include <algorithm>
+#include <complex>
+
+using namespace std;
+
+namespace {
+
+struct complex_dd {
+	dd_real re;
+	dd_real im;
+};
+
+inline complex_dd operator+(const complex_dd& a, const complex_dd& b) {
+	return { a.re + b.re, a.im + b.im };
+}
+
+inline complex_dd operator-(const complex_dd& a, const complex_dd& b) {
+	return { a.re - b.re, a.im - b.im };
+}
+
+inline complex_dd operator*(const complex_dd& a, const complex_dd& b) {
+	return { a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re };
+}
+
+inline complex_dd operator/(const complex_dd& a, const complex_dd& b) {
+	auto norm = b.re * b.re + b.im * b.im;
+	return { (a.re * b.re + a.im * b.im) / norm, (a.im * b.re - a.re * b.im) / norm };
+}
+
+inline double norm(const complex_dd& a) {
+	auto x = (double)a.re, y = (double)a.im;
+	return x * x + y * y;
+}
+
+struct Seed {
+	complex_dd c;
+	uint32_t   period;
+};
+
+// every iteration where |z| reaches a new minimum is the period of an atom domain containing c
+void atomDomains(const complex_dd& c, uint32_t max_period, vector<uint32_t>& periods)
+{
+	complex_dd z = c;
+	double min_norm = norm(z);
+
+	for (uint32_t n = 2; n <= max_period; ++n) {
+		z = z * z + c;
+
+		double zn = norm(z);
+		if (zn > 4.) break;
+		if (zn < min_norm) {
+			min_norm = zn;
+			periods.push_back(n);
+		}
+	}
+}
+
+} // namespace
+
+NucleusFinder::NucleusFinder()
+{
+	running     = false;
+	cancelled   = false;
+	seeds_done  = 0;
+	seeds_total = 0;
+}
+
+NucleusFinder::~NucleusFinder()
+{
+	cancel();
+}
+
+void NucleusFinder::start(dd_real cx, dd_real cy, double radius, uint32_t max_period)
+{
+	cancel();
+
+	{
+		lock_guard<mutex> lock(candidates_mutex);
+		candidates.clear();
+	}
+
+	seeds_done  = 0;
+	seeds_total = 0;
+	running     = true;
+
+	future = async(launch::async, [this, cx, cy, radius, max_period] {
+		search(cx, cy, radius, max_period);
+		running = false;
+	});
+}
+
+void NucleusFinder::cancel()
+{
+	if (future.valid()) {
+		cancelled = true;
+		future.get();
+		cancelled = false;
+	}
+}
+
+float NucleusFinder::getProgress() const
+{
+	return seeds_total ? (float)seeds_done / seeds_total : 0.f;
+}
+
+vector<NucleusFinder::Candidate> NucleusFinder::getCandidates() const
+{
+	lock_guard<mutex> lock(candidates_mutex);
+	return candidates;
+}
+
+size_t NucleusFinder::getCandidateCount() const
+{
+	lock_guard<mutex> lock(candidates_mutex);
+	return candidates.size();
+}
+
+bool NucleusFinder::getNearest(Candidate& candidate) const
+{
+	lock_guard<mutex> lock(candidates_mutex);
+	if (candidates.empty()) return false;
+
+	candidate = candidates.front();
+	return true;
+}
+
+void NucleusFinder::search(dd_real cx, dd_real cy, double radius, uint32_t max_period)
+{
+	complex_dd center = { cx, cy };
+
+	// the center contributes all of its nested atom domains, the grid only the innermost one
+	vector<Seed>     seeds;
+	vector<uint32_t> periods;
+
+	atomDomains(center, max_period, periods);
+	for (auto p : periods) seeds.push_back({ center, p });
+
+	for (int j = 0; j < grid_size; ++j) {
+		for (int i = 0; i < grid_size; ++i) {
+			if (cancelled) return;
+
+			complex_dd c = {
+				cx + dd_real(radius * (2. * (i + 0.5) / grid_size - 1.)),
+				cy + dd_real(radius * (2. * (j + 0.5) / grid_size - 1.))
+			};
+
+			periods.clear();
+			atomDomains(c, max_period, periods);
+			if (periods.empty()) continue;
+
+			auto p = periods.back();
+			auto same = [p](const Seed& s) { return s.period == p; };
+			if (none_of(seeds.begin(), seeds.end(), same))
+				seeds.push_back({ c, p });
+		}
+	}
+
+	seeds_total = (uint32_t)seeds.size();
+
+	// a step this small no longer moves the nucleus by a visible amount
+	double tolerance = max(radius * 1e-9, 1e-30);
+
+	for (auto& seed : seeds) {
+		complex_dd c = seed.c;
+		bool converged = false;
+
+		for (int step = 0; step < newton_steps && !converged; ++step) {
+			complex_dd z = { 0., 0. }, dz = { 0., 0. };
+
+			for (uint32_t n = 0; n < seed.period; ++n) {
+				if ((n & 1023) == 0 && cancelled) return;
+
+				dz = complex_dd{ 2., 0. } * z * dz + complex_dd{ 1., 0. };
+				z  = z * z + c;
+			}
+
+			auto delta = z / dz;
+			c          = c - delta;
+			converged  = norm(delta) < tolerance * tolerance;
+
+			if (!(norm(c - center) < 16. * radius * radius)) break; // wandered off (or NaN)
+		}
+
+		if (converged) {
+			// Newton on z_p may land on a nucleus of a divisor of p: the true period is the first
+			// n where a Newton step would not move c. the same pass estimates the atom size.
+			complex_dd z = { 0., 0. }, dz = { 0., 0. };
+			complex<double> l = 1., b = 1.;
+			uint32_t period = seed.period;
+
+			for (uint32_t n = 1; n <= seed.period; ++n) {
+				dz = complex_dd{ 2., 0. } * z * dz + complex_dd{ 1., 0. };
+				z  = z * z + c;
+
+				if (norm(z) < tolerance * tolerance * norm(dz)) {
+					period = n;
+					break;
+				}
+
+				complex<double> zd = { (double)z.re, (double)z.im };
+				l  = 2. * zd * l;
+				b += 1. / l;
+			}
+
+			Candidate candidate = {
+				c.re, c.im, period,
+				1. / std::abs(b * l * l),
+				sqrt(norm(c - center))
+			};
+
+			lock_guard<mutex> lock(candidates_mutex);
+
+			auto duplicate = [&](const Candidate& other) {
+				auto dx = (double)(other.x - candidate.x), dy = (double)(other.y - candidate.y);
+				return other.period == candidate.period && dx * dx + dy * dy < 1e6 * tolerance * tolerance;
+			};
+
+			if (none_of(candidates.begin(), candidates.end(), duplicate)) {
+				auto pos = upper_bound(candidates.begin(), candidates.end(), candidate, [](const Candidate& a, const Candidate& b) {
+					return a.distance < b.distance;
+				});
+				candidates.insert(pos, candidate);
+			}
+		}
+
+		++seeds_done;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <future>
+#include <atomic>
+
+#include "dd_real.h"
+
+// looks for minibrot nuclei around a point. atom domains (the iteration where |z| reaches a new
+// minimum) over a grid of seeds give candidate periods, then Newton-Raphson on z_p(c) = 0
+// converges to the period-p nucleus in double-double. the search runs on its own thread,
+// publishes candidates as they converge and can be cancelled between any two Newton steps.
+class NucleusFinder
+{
+public:
+	struct Candidate {
+		dd_real  x;
+		dd_real  y;
+		uint32_t period;
+		double   size;     // estimated radius of the minibrot
+		double   distance; // from the search center
+	};
+
+	NucleusFinder();
+	~NucleusFinder();
+
+	void start(dd_real cx, dd_real cy, double radius, uint32_t max_period);
+	void cancel();
+
+	inline bool isRunning() const { return running; }
+	float getProgress() const;
+
+	std::vector<Candidate> getCandidates() const;
+	size_t getCandidateCount() const;
+	bool getNearest(Candidate& candidate) const;
+
+	static constexpr int grid_size    = 8;
+	static constexpr int newton_steps = 64;
+
+private:
+	void search(dd_real cx, dd_real cy, double radius, uint32_t max_period);
+
+	std::future<void>     future;
+	std::atomic<bool>     running;
+	std::atomic<bool>     cancelled;
+	std::atomic<uint32_t> seeds_done;
+	std::atomic<uint32_t> seeds_total;
+
+	mutable std::mutex     candidates_mutex;
+	std::vector<Candidate> candidates;
+};
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "perf_counters.h"
+
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+
+atomic<bool> PerfCounters::enabled = false;
+
+static mutex  error_lock;
+static string error;
+
+PerfSample& PerfSample::operator+=(const PerfSample& other)
+{
+	cycles           += other.cycles;
+	instructions     += other.instructions;
+	branches         += other.branches;
+	branch_misses    += other.branch_misses;
+	cache_references += other.cache_references;
+	cache_misses     += other.cache_misses;
+	return *this;
+}
+
+void PerfCounters::Total::add(const PerfSample& sample)
+{
+	values[0] += sample.cycles;
+	values[1] += sample.instructions;
+	values[2] += sample.branches;
+	values[3] += sample.branch_misses;
+	values[4] += sample.cache_references;
+	values[5] += sample.cache_misses;
+}
+
+PerfSample PerfCounters::Total::load() const
+{
+	PerfSample sample;
+	sample.cycles           = values[0];
+	sample.instructions     = values[1];
+	sample.branches         = values[2];
+	sample.branch_misses    = values[3];
+	sample.cache_references = values[4];
+	sample.cache_misses     = values[5];
+	return sample;
+}
+
+void PerfCounters::Total::reset()
+{
+	for (auto& value : values) value = 0;
+}
+
+PerfCounters::Scope::Scope(Total& total)
+	: total(nullptr)
+{
+	if (enabled && read(start)) this->total = &total;
+}
+
+PerfCounters::Scope::~Scope()
+{
+	PerfSample end;
+	if (!total || !read(end)) return;
+
+	PerfSample delta;
+	delta.cycles           = end.cycles - start.cycles;
+	delta.instructions     = end.instructions - start.instructions;
+	delta.branches         = end.branches - start.branches;
+	delta.branch_misses    = end.branch_misses - start.branch_misses;
+	delta.cache_references = end.cache_references - start.cache_references;
+	delta.cache_misses     = end.cache_misses - start.cache_misses;
+	total->add(delta);
+}
+
+const char* PerfCounters::getError()
+{
+	lock_guard<mutex> guard(error_lock);
+	return error.c_str();
+}
+
+static void setError(const string& message)
+{
+	lock_guard<mutex> guard(error_lock);
+	if (error.empty()) error = message;
+}
+
+#ifdef __linux__
+
+namespace {
+	// in the order of the PerfSample fields
+	const uint64_t events[] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES,
+		PERF_COUNT_HW_CACHE_REFERENCES,
+		PERF_COUNT_HW_CACHE_MISSES
+	};
+	constexpr int event_count = sizeof(events) / sizeof(events[0]);
+
+	// one group per thread, cycles lead it. an event the CPU doesn't have is left out and reads 0.
+	struct Group {
+		bool tried  = false;
+		int  leader = -1;
+		int  fds[event_count];
+		int  index[event_count]; // position in the group read, -1 if not opened
+		int  opened = 0;
+
+		Group() {
+			for (int i = 0; i < event_count; ++i) fds[i] = index[i] = -1;
+		}
+		~Group() {
+			for (int i = 0; i < event_count; ++i)
+				if (fds[i] >= 0) close(fds[i]);
+		}
+
+		bool open() {
+			tried = true;
+
+			for (int i = 0; i < event_count; ++i) {
+				perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.size           = sizeof(attr);
+				attr.type           = PERF_TYPE_HARDWARE;
+				attr.config         = events[i];
+				attr.exclude_kernel = 1; // enough with perf_event_paranoid 2
+				attr.exclude_hv     = 1;
+				attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+				if (fd < 0) {
+					if (i > 0) continue;
+					setError(string("perf_event_open: ") + strerror(errno) +
+						(errno == EACCES || errno == EPERM ? " (check /proc/sys/kernel/perf_event_paranoid)" : ""));
+					return false;
+				}
+
+				if (i == 0) leader = fd;
+				fds[i]   = fd;
+				index[i] = opened++;
+			}
+			return true;
+		}
+
+		bool read(PerfSample& sample) {
+			if (leader < 0) return false;
+
+			// nr, time enabled, time running, then one value per opened event
+			uint64_t data[3 + event_count];
+			if (::read(leader, data, sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t))) return false;
+
+			// scaled up when the kernel had to multiplex the group with other counters
+			double scale = data[2] ? (double)data[1] / data[2] : 1.;
+
+			uint64_t values[event_count] = {};
+			for (int i = 0; i < event_count; ++i)
+				if (index[i] >= 0) values[i] = (uint64_t)(data[3 + index[i]] * scale);
+
+			sample.cycles           = values[0];
+			sample.instructions     = values[1];
+			sample.branches         = values[2];
+			sample.branch_misses    = values[3];
+			sample.cache_references = values[4];
+			sample.cache_misses     = values[5];
+			return true;
+		}
+	};
+
+	Group& threadGroup() {
+		thread_local Group group;
+		if (!group.tried) group.open();
+		return group;
+	}
+}
+
+bool PerfCounters::available()
+{
+	return threadGroup().leader >= 0;
+}
+
+bool PerfCounters::read(PerfSample& sample)
+{
+	return threadGroup().read(sample);
+}
+
+#else
+
+bool PerfCounters::available()
+{
+	setError("hardware counters are only read on Linux");
+	return false;
+}
+
+bool PerfCounters::read(PerfSample&)
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// hardware counters of the render work. Linux only: every worker thread opens its own group of
+// perf_event_open counters on first use and is read around each task it runs. everywhere else,
+// and in containers or with perf_event_paranoid too high, available() is false and the scopes
+// cost a branch.
+struct PerfSample
+{
+	uint64_t cycles           = 0;
+	uint64_t instructions     = 0;
+	uint64_t branches         = 0;
+	uint64_t branch_misses    = 0;
+	uint64_t cache_references = 0;
+	uint64_t cache_misses     = 0;
+
+	inline bool empty() const { return cycles == 0 && instructions == 0; }
+
+	inline double getIPC() const { return cycles ? (double)instructions / cycles : 0.; }
+	inline double getBranchMissRate() const { return branches ? (double)branch_misses / branches : 0.; }
+	inline double getCacheMissRate() const { return cache_references ? (double)cache_misses / cache_references : 0.; }
+
+	PerfSample& operator+=(const PerfSample& other);
+};
+
+class PerfCounters
+{
+	PerfCounters() = delete;
+
+public:
+	// summed over the threads of a render
+	class Total {
+	public:
+		void add(const PerfSample& sample);
+		PerfSample load() const;
+		void reset();
+
+	private:
+		std::atomic<uint64_t> values[6] = {};
+	};
+
+	// counts the calling thread until it goes out of scope, if the counters are enabled
+	class Scope {
+	public:
+		Scope(Total& total);
+		~Scope();
+
+	private:
+		Total*     total;
+		PerfSample start;
+	};
+
+	// opens the counters of the calling thread if that hasn't been tried yet
+	static bool available();
+	// why they are not, empty while available() hasn't failed. set once, the pointer stays valid.
+	static const char* getError();
+
+	// off by default, reading the counters costs two system calls per task
+	static inline bool isEnabled() { return enabled; }
+	static inline void setEnabled(bool enabled) { PerfCounters::enabled = enabled; }
+
+private:
+	static bool read(PerfSample& sample);
+
+	static std::atomic<bool> enabled;
+};
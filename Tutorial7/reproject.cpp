@@ -0,0 +1,173 @@
+#include "reproject.h"
+
+#include <cmath>
+#include <algorithm>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/blocked_range.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "trace.h"
+
+using namespace std;
+using namespace oneapi;
+
+// source coordinates are 16.16 fixed point, the filter weights are the top 8 bits of the fraction
+static constexpr int    frac_bits = 16;
+static constexpr double one       = 1 << frac_bits;
+
+// a + (b - a) * f / 256 for each channel, f in [0, 256). two channels share a multiply, one in
+// each half of the word, their products stay below 2^16.
+static inline uint32_t lerp(uint32_t a, uint32_t b, uint32_t f)
+{
+	uint32_t rb = ((a & 0xff00ff) * (256 - f) + (b & 0xff00ff) * f) >> 8 & 0xff00ff;
+	uint32_t ag = ((a >> 8 & 0xff00ff) * (256 - f) + (b >> 8 & 0xff00ff) * f) & 0xff00ff00;
+	return rb | ag;
+}
+
+// at source x u (16.16) between two rows, the columns clamped to the row
+static inline uint32_t sample(const uint32_t* row0, const uint32_t* row1, uint32_t fy, int32_t u, int width)
+{
+	int      x0 = SDL_clamp(u >> frac_bits, 0, width - 1);
+	int      x1 = SDL_min(x0 + 1, width - 1);
+	uint32_t fx = u >> (frac_bits - 8) & 0xff;
+	if (u < 0) x1 = x0; // left of the first center
+
+	return lerp(lerp(row0[x0], row0[x1], fx), lerp(row1[x0], row1[x1], fx), fy);
+}
+
+#ifdef __AVX2__
+// lerp() on 8 pixels, f holds each pixel's weight in both 16-bit halves
+static inline __m256i lerp8(__m256i a, __m256i b, __m256i f)
+{
+	auto mask = _mm256_set1_epi32(0xff00ff);
+	auto g    = _mm256_sub_epi16(_mm256_set1_epi16(256), f);
+
+	auto rb = _mm256_add_epi16(
+		_mm256_mullo_epi16(_mm256_and_si256(a, mask), g),
+		_mm256_mullo_epi16(_mm256_and_si256(b, mask), f));
+	auto ag = _mm256_add_epi16(
+		_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(a, 8), mask), g),
+		_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(b, 8), mask), f));
+
+	return _mm256_or_si256(_mm256_srli_epi16(rb, 8), _mm256_andnot_si256(mask, ag));
+}
+#endif
+
+// where a row of the destination lands in the source
+struct RowSpan {
+	const uint32_t* row0;
+	const uint32_t* row1;
+	uint32_t        fy;
+	int32_t         u_begin; // source x of pixel begin, 16.16
+	int32_t         du;
+	int             begin;   // [begin, end) lands in the source
+	int             end;
+	int             inner_begin; // [inner_begin, inner_end) has both columns inside it
+	int             inner_end;
+
+	inline int32_t u(int x) const { return u_begin + (x - begin) * du; }
+};
+
+static bool findSpan(const SDL_Surface* src, const SDL_Surface* dst, const Reprojection& r, int y, RowSpan& span)
+{
+	// a step this large shows less than a pixel of the source, and wouldn't fit 16.16
+	if (!(r.scale_x > 0. && r.scale_x < 4096. && r.scale_y > 0.)) return false;
+
+	// source x and y with the pixel centers on integers
+	double v = (y + 0.5) * r.scale_y + r.offset_y - 0.5;
+	if (!(v >= -0.5 && v < src->h - 0.5)) return false;
+
+	auto v_fixed = (int32_t)lround(v * one);
+	int  y0      = SDL_clamp(v_fixed >> frac_bits, 0, src->h - 1);
+	int  y1      = v_fixed < 0 ? y0 : SDL_min(y0 + 1, src->h - 1);
+
+	span.row0 = (const uint32_t*)src->pixels + y0 * src->w;
+	span.row1 = (const uint32_t*)src->pixels + y1 * src->w;
+	span.fy   = v_fixed >> (frac_bits - 8) & 0xff;
+
+	// u(x) = x * scale_x + c, the span is where it is in [-0.5, w - 0.5)
+	double c     = 0.5 * r.scale_x + r.offset_x - 0.5;
+	auto   first = [&](double u) { return (int)SDL_clamp(ceil((u - c) / r.scale_x), 0., (double)dst->w); };
+
+	span.begin = first(-0.5);
+	span.end   = SDL_max(first(src->w - 0.5), span.begin);
+	if (span.begin == span.end) return false;
+
+	span.u_begin = (int32_t)lround((span.begin * r.scale_x + c) * one);
+	span.du      = (int32_t)lround(r.scale_x * one);
+
+	// no clamping where u is in [0, w - 1), checked on the fixed point values it is sampled at
+	span.inner_begin = SDL_clamp(first(0.), span.begin, span.end);
+	span.inner_end   = SDL_clamp(first(src->w - 1.), span.inner_begin, span.end);
+	while (span.inner_begin < span.inner_end && span.u(span.inner_begin) < 0) ++span.inner_begin;
+	while (span.inner_end > span.inner_begin && (span.u(span.inner_end - 1) >> frac_bits) > src->w - 2) --span.inner_end;
+
+	return true;
+}
+
+template <bool vector>
+static void reprojectRows(const SDL_Surface* src, SDL_Surface* dst, const Reprojection& r, int y_begin, int y_end)
+{
+	for (int y = y_begin; y < y_end; ++y) {
+		auto*   out = (uint32_t*)dst->pixels + y * dst->w;
+		RowSpan span;
+
+		if (!findSpan(src, dst, r, y, span)) {
+			fill_n(out, dst->w, 0u);
+			continue;
+		}
+
+		fill_n(out, span.begin, 0u);
+		fill_n(out + span.end, dst->w - span.end, 0u);
+
+		int x = span.begin;
+		for (; x < span.inner_begin; ++x)
+			out[x] = sample(span.row0, span.row1, span.fy, span.u(x), src->w);
+
+#ifdef __AVX2__
+		if (vector) {
+			auto u    = _mm256_add_epi32(_mm256_set1_epi32(span.u(x)), _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(span.du)));
+			auto step = _mm256_set1_epi32(span.du * 8);
+			auto fy   = _mm256_set1_epi32(span.fy | span.fy << 16);
+			auto low  = _mm256_set1_epi32(0xff);
+
+			for (; x + 8 <= span.inner_end; x += 8) {
+				auto x0 = _mm256_srai_epi32(u, frac_bits);
+				auto fx = _mm256_and_si256(_mm256_srli_epi32(u, frac_bits - 8), low);
+				fx      = _mm256_or_si256(fx, _mm256_slli_epi32(fx, 16));
+
+				auto top    = lerp8(_mm256_i32gather_epi32((const int*)span.row0, x0, 4), _mm256_i32gather_epi32((const int*)span.row0 + 1, x0, 4), fx);
+				auto bottom = lerp8(_mm256_i32gather_epi32((const int*)span.row1, x0, 4), _mm256_i32gather_epi32((const int*)span.row1 + 1, x0, 4), fx);
+				_mm256_storeu_si256((__m256i*)(out + x), lerp8(top, bottom, fy));
+
+				u = _mm256_add_epi32(u, step);
+			}
+		}
+#endif
+
+		for (; x < span.end; ++x)
+			out[x] = sample(span.row0, span.row1, span.fy, span.u(x), src->w);
+	}
+}
+
+template <bool vector>
+static void reprojectAll(const SDL_Surface* src, SDL_Surface* dst, const Reprojection& r)
+{
+	TRACE_SCOPE("reproject");
+	tbb::parallel_for(tbb::blocked_range<int>(0, dst->h), [&](const tbb::blocked_range<int>& rows) {
+		reprojectRows<vector>(src, dst, r, rows.begin(), rows.end());
+	});
+}
+
+void reproject(const SDL_Surface* src, SDL_Surface* dst, const Reprojection& r)
+{
+	reprojectAll<true>(src, dst, r);
+}
+
+void reprojectScalar(const SDL_Surface* src, SDL_Surface* dst, const Reprojection& r)
+{
+	reprojectAll<false>(src, dst, r);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+// a zoom and a pan between two views of the same plane: the destination at (x, y), in pixels
+// from its top left edge, shows the source at (x * scale_x + offset_x, y * scale_y + offset_y).
+// pixel centers are at +0.5 in both.
+struct Reprojection {
+	double scale_x  = 1.;
+	double scale_y  = 1.;
+	double offset_x = 0.;
+	double offset_y = 0.;
+};
+
+// bilinear with 8-bit weights, destination pixels whose center falls outside of src are black.
+// each row finds up front the span that lands in src and the part of it that needs no clamping,
+// that part runs 8 pixels at a time where AVX2 is enabled. src and dst must not overlap.
+void reproject(const SDL_Surface* src, SDL_Surface* dst, const Reprojection& r);
+
+// the same without AVX2, for checking the vector path against
+void reprojectScalar(const SDL_Surface* src, SDL_Surface* dst, const Reprojection& r);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __CUDACC__
+#define SAMPLING_FUNC __host__ __device__ __forceinline__
+#else
+#define SAMPLING_FUNC inline
+#endif
+
+// sample positions inside a pixel, addressed by (pixel, sample index, seed) alone. nothing is
+// carried from one sample to the next, so any sample can be drawn on any thread in any order and
+// a render resumed or split across threads reproduces the same bits.
+namespace sampling {
+
+enum class Sequence {
+	Random = 0, // white noise, for comparison
+	R2     = 1, // additive recurrence on the plastic constant, rotated per pixel
+	Sobol  = 2  // Owen-scrambled Sobol (0,2)-sequence, shuffled and scrambled per pixel
+};
+
+// counter-based integer hash (lowbias32), every bit of the input affects every output bit
+SAMPLING_FUNC uint32_t hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+SAMPLING_FUNC uint32_t hash(uint32_t a, uint32_t b)
+{
+	return hash(a ^ (hash(b) + 0x9e3779b9u + (a << 6) + (a >> 2)));
+}
+
+SAMPLING_FUNC float to_unit(uint32_t x)
+{
+	return (x >> 8) * (1.f / 16777216.f);
+}
+
+SAMPLING_FUNC uint32_t reverse_bits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// hash-based Owen scrambling (Burley 2020): every bit is flipped depending only on the bits
+// above it, done as a Laine-Karras permutation on the bit-reversed value
+SAMPLING_FUNC uint32_t owen_scramble(uint32_t x, uint32_t seed)
+{
+	x  = reverse_bits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverse_bits(x);
+}
+
+// first two Sobol dimensions: the van der Corput sequence and its Pascal matrix companion
+SAMPLING_FUNC uint32_t sobol0(uint32_t i)
+{
+	return reverse_bits(i);
+}
+
+SAMPLING_FUNC uint32_t sobol1(uint32_t i)
+{
+	uint32_t r = 0;
+	for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1)
+		if (i & 1) r ^= v;
+	return r;
+}
+
+// sample `index` of pixel `pixel`, as an offset in [0, 1)^2 from the pixel corner
+SAMPLING_FUNC void sample2D(Sequence sequence, uint32_t pixel, uint32_t index, uint32_t seed, float& x, float& y)
+{
+	uint32_t key = hash(pixel, seed);
+
+	if (sequence == Sequence::R2) {
+		// 1 / g and 1 / g^2 for the plastic constant g, in 0.32 fixed point
+		uint32_t shift_x = hash(key, 0), shift_y = hash(key, 1);
+		x = to_unit(shift_x + index * 3242174889u);
+		y = to_unit(shift_y + index * 2447445414u);
+	} else if (sequence == Sequence::Sobol) {
+		uint32_t i = owen_scramble(index, hash(key, 2));
+		x = to_unit(owen_scramble(sobol0(i), hash(key, 0)));
+		y = to_unit(owen_scramble(sobol1(i), hash(key, 1)));
+	} else {
+		uint32_t h = hash(key, index);
+		x = to_unit(h);
+		y = to_unit(hash(h));
+	}
+}
+
+} // namespace sampling
+
+#undef SAMPLING_FUNC
\ No newline at end of file
@@ -0,0 +1,192 @@
+#define SDL_MAIN_HANDLED
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+
+#include "view_spec.h"
+#include "bench_views.h"
+
+// sweeps the TBB backend over thread counts, grain sizes and partitioners, prints the strong
+// scaling of every configuration and writes the fastest one as a profile the other programs read:
+//   Tutorial7Scaling --profile tbb.profile
+//   Tutorial7 --view tbb.profile
+
+using namespace std;
+
+static const char* usage =
+	"options:\n"
+	"  --views <a,b,..>         catalogue entries to render, all by default\n"
+	"  --size <w>x<h>           image size, 640x360 by default\n"
+	"  --iter <n>               iteration limit, 1024 by default\n"
+	"  --precision <p>          double by default\n"
+	"  --threads <n,..>         arena concurrencies, powers of two up to every core by default\n"
+	"  --grains <n,..>          grain sizes, 1,4,16,64 by default\n"
+	"  --partitioners <p,..>    auto, simple, static, affinity, all by default\n"
+	"  --repeat <n>             timed renders per view, the median is kept, 3 by default\n"
+	"  --csv <file>             write every measurement as CSV\n"
+	"  --profile <file>         where the best configuration goes, tbb.profile by default\n";
+
+struct ScalingResult
+{
+	string   partitioner;
+	uint32_t grain      = 0;
+	uint32_t threads    = 0;
+	double   time       = 0.; // seconds, summed over the views
+	double   speedup    = 1.; // against the fewest threads of the same configuration
+	double   efficiency = 1.; // speedup per thread
+};
+
+static vector<string> split(const string& list)
+{
+	vector<string> items;
+	stringstream ss(list);
+	for (string item; getline(ss, item, ',');)
+		if (!item.empty()) items.push_back(item);
+	return items;
+}
+
+int main(int argc, char* argv[])
+{
+	vector<string> views, threads, grains = { "1", "4", "16", "64" };
+	vector<string> partitioners = { "auto", "simple", "static", "affinity" };
+	string size = "640x360", iter = "1024", precision = "double", csv, profile = "tbb.profile";
+	int repeat = 3;
+
+	for (auto& view : bench_views) views.push_back(view.name);
+
+	auto hardware = max(thread::hardware_concurrency(), 1u);
+	for (uint32_t n = 1; n < hardware; n *= 2) threads.push_back(to_string(n));
+	threads.push_back(to_string(hardware));
+
+	for (int i = 1; i < argc; ++i) {
+		string key = argv[i];
+		if (key == "--help" || i + 1 == argc) {
+			cout << "usage: " << argv[0] << " [options]\n" << usage;
+			return key == "--help" ? 0 : -1;
+		}
+		string value = argv[++i];
+
+		bool ok = true;
+		if      (key == "--views")        views        = split(value);
+		else if (key == "--size")         size         = value;
+		else if (key == "--iter")         iter         = value;
+		else if (key == "--precision")    precision    = value;
+		else if (key == "--threads")      threads      = split(value);
+		else if (key == "--grains")       grains       = split(value);
+		else if (key == "--partitioners") partitioners = split(value);
+		else if (key == "--repeat")       ok = (istringstream(value) >> repeat) && repeat > 0;
+		else if (key == "--csv")          csv          = value;
+		else if (key == "--profile")      profile      = value;
+		else ok = false;
+
+		if (!ok) {
+			cout << "error: invalid option " << key << " " << value << "\n\n" << usage;
+			return -1;
+		}
+	}
+
+	// the sweep goes through ViewSpec, so its names and numbers are checked like everywhere else
+	ViewSpec spec;
+	string error;
+	spec.backend = ViewSpec::Backend::CPU_TBB;
+	if (!spec.set("size", size, error) || !spec.set("iter", iter, error) || !spec.set("precision", precision, error)) {
+		cout << "error: " << error << "\n";
+		return -1;
+	}
+
+	vector<const BenchView*> view_list;
+	for (auto& name : views) {
+		auto view = find_if(begin(bench_views), end(bench_views), [&](const BenchView& v) { return name == v.name; });
+		if (view == end(bench_views)) {
+			cout << "error: unknown view \"" << name << "\"\n";
+			return -1;
+		}
+		view_list.push_back(view);
+	}
+
+	auto mandelbrot = spec.createHeadless();
+	vector<ScalingResult> results;
+
+	printf("%zu views at %dx%d, %u iterations, median of %d renders\n\n", view_list.size(), spec.width, spec.height,
+		spec.iter, repeat);
+	printf("%-11s %6s %8s %11s %8s %10s\n", "partitioner", "grain", "threads", "time", "speedup", "efficiency");
+
+	for (auto& partitioner : partitioners)
+	for (auto& grain : grains) {
+		size_t first = results.size();
+
+		for (auto& n : threads) {
+			if (!spec.set("partitioner", partitioner, error) || !spec.set("grain", grain, error) ||
+				!spec.set("threads", n, error) || spec.threads == 0) {
+				cout << "error: " << (error.empty() ? "thread counts start at 1" : error) << "\n";
+				return -1;
+			}
+
+			double total = 0.;
+			for (auto* view : view_list) {
+				spec.set("x", view->x, error);
+				spec.set("y", view->y, error);
+				spec.scale = view->scale;
+
+				vector<double> runs;
+				for (int run = -1; run < repeat; ++run) {
+					spec.apply(*mandelbrot); // invalidates the previous image
+
+					auto start = chrono::steady_clock::now();
+					mandelbrot->render(false);
+					chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+					if (run >= 0) runs.push_back(elapsed.count());
+				}
+
+				sort(runs.begin(), runs.end());
+				total += runs[runs.size() / 2];
+			}
+
+			// strong scaling: the same work on more threads, against the fewest threads measured
+			auto base = first < results.size() ? results[first] : ScalingResult{ partitioner, spec.grain, spec.threads, total };
+			double speedup    = base.time / total;
+			double efficiency = speedup * base.threads / spec.threads;
+
+			results.push_back({ partitioner, spec.grain, spec.threads, total, speedup, efficiency });
+
+			printf("%-11s %6u %8u %9.1fms %7.2fx %9.0f%%\n", partitioner.c_str(), spec.grain, spec.threads,
+				total * 1e3, speedup, efficiency * 100.);
+		}
+	}
+
+	auto best = *min_element(results.begin(), results.end(),
+		[](const ScalingResult& a, const ScalingResult& b) { return a.time < b.time; });
+
+	printf("\nbest: %s partitioner, grain %u, %u threads, %.1fms\n", best.partitioner.c_str(), best.grain,
+		best.threads, best.time * 1e3);
+
+	if (!csv.empty()) {
+		ofstream file(csv);
+		file << "partitioner,grain,threads,time_ms,speedup,efficiency\n";
+		for (auto& r : results)
+			file << r.partitioner << "," << r.grain << "," << r.threads << "," << r.time * 1e3 << "," << r.speedup << ","
+			     << r.efficiency << "\n";
+		if (!file.good()) cout << "error: couldn't write " << csv << "\n";
+	}
+
+	// only the tuning keys, so it can be combined with any view: --view tbb.profile --view deep.view
+	ofstream file(profile);
+	file << "# fastest configuration on this machine (" << hardware << " hardware threads), "
+	     << view_list.size() << " views at " << size << ", " << iter << " iterations\n";
+	file << "threads = " << best.threads << "\n";
+	file << "grain = " << best.grain << "\n";
+	file << "partitioner = " << best.partitioner << "\n";
+
+	if (!file.good()) {
+		cout << "error: couldn't write " << profile << "\n";
+		return -1;
+	}
+	cout << "saved: " << profile << "\n";
+
+	return 0;
+}
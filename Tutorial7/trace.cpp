@@ -0,0 +1,103 @@
+#include "trace.h"
+
+#ifdef MANDELBROT_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+	// written by its thread only. head counts every span ever recorded, so a reader can tell
+	// which slots the writer may have reused while it was copying them.
+	struct Ring {
+		Trace::Span      spans[Trace::ring_size];
+		atomic<uint64_t> head = 0;
+		uint32_t         tid  = 0;
+	};
+
+	// rings outlive their threads, a pool worker that exited still shows up in the dump
+	mutex                     rings_lock;
+	vector<unique_ptr<Ring>>& rings() {
+		static vector<unique_ptr<Ring>> rings;
+		return rings;
+	}
+
+	const auto epoch = chrono::steady_clock::now();
+
+	Ring* registerThread() {
+		lock_guard<mutex> guard(rings_lock);
+		auto& list = rings();
+		list.push_back(make_unique<Ring>());
+		list.back()->tid = (uint32_t)list.size();
+		return list.back().get();
+	}
+}
+
+int64_t Trace::now()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const Span& span)
+{
+	thread_local Ring* ring = registerThread();
+
+	auto head = ring->head.load(memory_order_relaxed);
+	ring->spans[head % ring_size] = span;
+	ring->head.store(head + 1, memory_order_release);
+}
+
+bool Trace::dump(const string& path, double seconds)
+{
+	auto since = now() - (int64_t)(seconds * 1e9);
+
+	ofstream file(path);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	bool first = true;
+	char line[256];
+
+	lock_guard<mutex> guard(rings_lock);
+	for (auto& ring : rings()) {
+		auto head  = ring->head.load(memory_order_acquire);
+		auto count = min<uint64_t>(head, ring_size);
+
+		vector<Span> spans(count);
+		for (uint64_t i = 0; i < count; ++i)
+			spans[i] = ring->spans[(head - count + i) % ring_size];
+
+		// the thread kept recording meanwhile, drop the slots it may have reused. it may also be
+		// writing slot head2 already, before publishing head2 + 1.
+		auto head2  = ring->head.load(memory_order_acquire);
+		auto reused = (int64_t)head2 + 1 - (int64_t)ring_size - (int64_t)(head - count);
+		auto skip   = (size_t)clamp<int64_t>(reused, 0, (int64_t)count);
+
+		snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+			first ? "" : ",\n", ring->tid, ring->tid);
+		file << line;
+		first = false;
+
+		for (auto span = spans.begin() + skip; span != spans.end(); ++span) {
+			if (span->end < since) continue;
+
+			// complete events, timestamps in microseconds
+			int n = snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+				span->name, ring->tid, span->begin / 1e3, (span->end - span->begin) / 1e3);
+			if (span->x != INT32_MIN)
+				n += snprintf(line + n, sizeof(line) - n, ",\"args\":{\"x\":%d,\"y\":%d}", span->x, span->y);
+			snprintf(line + n, sizeof(line) - n, "}");
+			file << line;
+		}
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+// span instrumentation, dumped as Chrome trace JSON for chrome://tracing or ui.perfetto.dev.
+// only built with MANDELBROT_TRACE defined (the debug configuration of Tutorial7),
+// otherwise the macros expand to nothing and trace.cpp is empty.
+//
+//   TRACE_SCOPE("draw");               a span from here to the end of the block
+//   TRACE_SCOPE_XY("tile", w, h);      the same, with two numbers shown as its arguments
+
+#ifdef MANDELBROT_TRACE
+
+#include <stdint.h>
+#include <string>
+
+class Trace {
+	Trace() = delete;
+
+public:
+	// spans kept per thread, the oldest are overwritten
+	static constexpr size_t ring_size = 1 << 15;
+
+	struct Span {
+		const char* name;
+		int64_t     begin; // ns since the start of the program
+		int64_t     end;
+		int32_t     x;
+		int32_t     y;
+	};
+
+	class Scope {
+	public:
+		inline Scope(const char* name, int32_t x = INT32_MIN, int32_t y = INT32_MIN)
+			: span{ name, now(), 0, x, y } {}
+		inline ~Scope() {
+			span.end = now();
+			record(span);
+		}
+
+	private:
+		Span span;
+	};
+
+	static int64_t now();
+
+	// lock-free, every thread writes only its own ring buffer
+	static void record(const Span& span);
+
+	// writes the spans that ended in the last seconds
+	static bool dump(const std::string& path, double seconds);
+};
+
+#define TRACE_CONCAT_DETAIL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_DETAIL(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_SCOPE_XY(name, x, y) Trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name, (int32_t)(x), (int32_t)(y))
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_XY(name, x, y)
+
+#endif
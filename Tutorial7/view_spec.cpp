@@ -0,0 +1,360 @@
+#include "view_spec.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "mandelbrot_tbb.h"
+#include "mandelbrot_bignum.h"
+
+using namespace std;
+
+using Precision = Mandelbrot::Precision;
+
+const char* ViewSpec::usage =
+	"options, also accepted as \"key = value\" lines by --view:\n"
+	"  --view <file>            read options from a file, later options override it\n"
+	"  --x <re>, --y <im>       view center, up to ~32 significant digits\n"
+	"  --scale <s>              half the view height\n"
+	"  --iter <n>               iteration limit\n"
+	"  --colormap <name|idx>    gray, ultra, viridis, magma, inferno, turbo\n"
+	"  --color-scale <s>        colormap repetitions over the iteration range\n"
+	"  --smooth <0|1>           smooth coloring\n"
+	"  --precision <p>          auto, double, double-double, fixed, fixed128, fixed192, fixed256\n"
+	"  --samples <n>            samples per pixel\n"
+	"  --samples-per-pass <n>   samples added to a pixel per pass\n"
+	"  --sequence <s>           random, r2, sobol\n"
+	"  --seed <n>               sample sequence seed\n"
+	"  --adaptive <0|1>         only refine pixels that have not converged\n"
+	"  --tolerance <t>          adaptive sampling tolerance, in luminance levels\n"
+	"  --budget <n>             adaptive sampling budget per pass\n"
+	"  --size <w>x<h>           image size\n"
+	"  --backend <b>            cpu, tbb, bignum\n"
+	"  --threads <n>            worker threads for tbb and bignum, 0 for every core\n"
+	"  --grain <n>              smallest tile a tbb task is split down to, in pixels\n"
+	"  --partitioner <p>        auto, simple, static, affinity\n"
+	"  --output <file>          .png, or .raw for 32-bit 0xAARRGGBB pixels in native byte order\n";
+
+static const char* colormap_names[]    = { "gray", "ultra", "viridis", "magma", "inferno", "turbo" };
+static const char* precision_names[]   = { "auto", "double", "double-double", "fixed", "fixed128", "fixed192", "fixed256" };
+static const char* sequence_names[]    = { "random", "r2", "sobol" };
+static const char* backend_names[]     = { "cpu", "tbb", "bignum" };
+static const char* partitioner_names[] = { "auto", "simple", "static", "affinity" };
+
+template <size_t N>
+static bool parseName(const string& value, const char* (&names)[N], uint32_t& idx)
+{
+	for (idx = 0; idx < N; ++idx)
+		if (value == names[idx]) return true;
+	return false;
+}
+
+template <class T>
+static bool parseNumber(const string& value, T& result)
+{
+	istringstream is(value);
+	is >> result;
+	return !is.fail() && is.eof();
+}
+
+static bool parseBool(const string& value, bool& result)
+{
+	bool on  = value == "1" || value == "true" || value == "on";
+	bool off = value == "0" || value == "false" || value == "off";
+
+	if (on || off) result = on;
+	return on || off;
+}
+
+static dd_real power10(int exponent)
+{
+	dd_real p = 1.;
+	for (int i = 0; i < abs(exponent); ++i) p = p * 10.;
+	return exponent < 0 ? dd_real(1.) / p : p;
+}
+
+// digits are accumulated in double-double, so a center keeps all the digits it was saved with
+static bool parseReal(const string& text, dd_real& value)
+{
+	size_t i = 0;
+	bool negative = false;
+	if (i < text.size() && (text[i] == '+' || text[i] == '-'))
+		negative = text[i++] == '-';
+
+	dd_real mantissa = 0.;
+	int exponent = 0, digits = 0;
+	bool point = false;
+
+	for (; i < text.size(); ++i) {
+		if (text[i] == '.' && !point) {
+			point = true;
+		} else if ('0' <= text[i] && text[i] <= '9') {
+			mantissa = mantissa * 10. + dd_real(text[i] - '0');
+			exponent -= point;
+			++digits;
+		} else break;
+	}
+	if (!digits) return false;
+
+	if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+		int e;
+		if (!parseNumber(text.substr(i + 1), e)) return false;
+		exponent += e;
+	} else if (i != text.size()) return false;
+
+	value = exponent < 0 ? mantissa / power10(-exponent) : mantissa * power10(exponent);
+	if (negative) value = -value;
+	return true;
+}
+
+static string formatReal(dd_real value)
+{
+	if (value.hi == 0.) return "0";
+
+	string result;
+	if (value.hi < 0.) {
+		result = "-";
+		value  = -value;
+	}
+
+	int exponent = (int)floor(log10(value.hi));
+	value = value / power10(exponent);
+	if (value.hi >= 10.) {
+		value = value / dd_real(10.);
+		++exponent;
+	} else if (value.hi < 1.) {
+		value = value * 10.;
+		--exponent;
+	}
+
+	// one digit at a time, 32 of them is all double-double can hold
+	for (int i = 0; i < 32; ++i) {
+		auto digit = SDL_clamp((int)floor(value.hi), 0, 9);
+		if ((value - dd_real(digit)).hi < 0. && digit > 0) --digit;
+
+		result += (char)('0' + digit);
+		if (i == 0) result += '.';
+		value = (value - dd_real(digit)) * 10.;
+	}
+
+	return result + "e" + to_string(exponent);
+}
+
+const char* ViewSpec::getName(Precision precision)
+{
+	return precision_names[(int)precision];
+}
+
+bool ViewSpec::set(const string& key, const string& value, string& error)
+{
+	uint32_t idx;
+	bool ok = true;
+
+	if      (key == "x")                ok = parseReal(value, x);
+	else if (key == "y")                ok = parseReal(value, y);
+	else if (key == "scale")            ok = parseNumber(value, scale) && scale > 0.;
+	else if (key == "iter")             ok = parseNumber(value, iter) && iter > 0;
+	else if (key == "color-scale")      ok = parseNumber(value, color_scale);
+	else if (key == "smooth")           ok = parseBool(value, smooth);
+	else if (key == "samples")          ok = parseNumber(value, samples) && samples > 0;
+	else if (key == "samples-per-pass") ok = parseNumber(value, samples_per_pass) && samples_per_pass > 0;
+	else if (key == "seed")             ok = parseNumber(value, seed);
+	else if (key == "adaptive")         ok = parseBool(value, adaptive);
+	else if (key == "tolerance")        ok = parseNumber(value, tolerance) && tolerance > 0.;
+	else if (key == "budget")           ok = parseNumber(value, budget) && budget > 0;
+	else if (key == "threads")          ok = parseNumber(value, threads);
+	else if (key == "grain")            ok = parseNumber(value, grain) && grain > 0;
+	else if (key == "output")           output = value;
+	else if (key == "colormap") {
+		ok = parseName(value, colormap_names, idx) || (parseNumber(value, idx) && idx < 6);
+		colormap = idx;
+	} else if (key == "precision") {
+		if ((ok = parseName(value, precision_names, idx))) precision = (Precision)idx;
+	} else if (key == "sequence") {
+		if ((ok = parseName(value, sequence_names, idx))) sequence = (sampling::Sequence)idx;
+	} else if (key == "backend") {
+		if ((ok = parseName(value, backend_names, idx))) backend = (Backend)idx;
+	} else if (key == "partitioner") {
+		if ((ok = parseName(value, partitioner_names, idx))) partitioner = (MandelbrotTBB::Partitioner)idx;
+	} else if (key == "size") {
+		auto sep = value.find('x');
+		ok = sep != string::npos && parseNumber(value.substr(0, sep), width) && parseNumber(value.substr(sep + 1), height) &&
+			width > 0 && height > 0;
+	} else {
+		error = "unknown option \"" + key + "\"";
+		return false;
+	}
+
+	if (!ok) error = "invalid value \"" + value + "\" for " + key;
+	return ok;
+}
+
+bool ViewSpec::parseArgs(int argc, char* argv[], string& error)
+{
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg.rfind("--", 0) != 0) {
+			error = "unexpected argument \"" + arg + "\"";
+			return false;
+		}
+
+		string key = arg.substr(2), value;
+		auto eq    = key.find('=');
+
+		if (eq != string::npos) {
+			value = key.substr(eq + 1);
+			key   = key.substr(0, eq);
+		} else if (i + 1 < argc) {
+			value = argv[++i];
+		} else {
+			error = "missing value for " + arg;
+			return false;
+		}
+
+		if (key == "view" ? !load(value, error) : !set(key, value, error)) return false;
+	}
+	return true;
+}
+
+bool ViewSpec::load(const string& path, string& error)
+{
+	ifstream file(path);
+	if (!file) {
+		error = "couldn't open " + path;
+		return false;
+	}
+
+	auto trim = [](const string& s) {
+		auto begin = s.find_first_not_of(" \t\r");
+		auto end   = s.find_last_not_of(" \t\r");
+		return begin == string::npos ? string() : s.substr(begin, end - begin + 1);
+	};
+
+	string line;
+	for (int n = 1; getline(file, line); ++n) {
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty()) continue;
+
+		auto eq = line.find('=');
+		if (eq == string::npos || !set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)), error)) {
+			if (eq == string::npos) error = "expected \"key = value\"";
+			error = path + ":" + to_string(n) + ": " + error;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ViewSpec::save(const string& path) const
+{
+	ofstream file(path);
+
+	file << "x = " << formatReal(x) << "\n";
+	file << "y = " << formatReal(y) << "\n";
+	file.precision(17);
+	file << "scale = " << scale << "\n";
+	file << "iter = " << iter << "\n";
+	file << "colormap = " << colormap_names[colormap] << "\n";
+	file << "color-scale = " << color_scale << "\n";
+	file << "smooth = " << smooth << "\n";
+	file << "precision = " << precision_names[(int)precision] << "\n";
+	file << "samples = " << samples << "\n";
+	file << "samples-per-pass = " << samples_per_pass << "\n";
+	file << "sequence = " << sequence_names[(int)sequence] << "\n";
+	file << "seed = " << seed << "\n";
+	file << "adaptive = " << adaptive << "\n";
+	file << "tolerance = " << tolerance << "\n";
+	file << "budget = " << budget << "\n";
+	file << "size = " << width << "x" << height << "\n";
+	file << "backend = " << backend_names[(int)backend] << "\n";
+	file << "threads = " << threads << "\n";
+	file << "grain = " << grain << "\n";
+	file << "partitioner = " << partitioner_names[(int)partitioner] << "\n";
+	if (!output.empty()) file << "output = " << output << "\n";
+
+	return file.good();
+}
+
+void ViewSpec::apply(Mandelbrot& mandelbrot) const
+{
+	mandelbrot.setPosition(x, y);
+	mandelbrot.setScale(scale);
+	mandelbrot.setIteration(iter);
+	mandelbrot.setColormap(colormap);
+	mandelbrot.setColorScale(color_scale);
+	mandelbrot.setColorSmooth(smooth);
+	mandelbrot.setPrecision(precision);
+	mandelbrot.setTotalSample(samples);
+	mandelbrot.setSamplePerLaunch(samples_per_pass);
+	mandelbrot.setSampleSequence(sequence);
+	mandelbrot.setSampleSeed(seed);
+	mandelbrot.setAdaptiveSampling(adaptive);
+	mandelbrot.setSampleTolerance(tolerance);
+	mandelbrot.setSampleBudget(budget);
+
+	if (auto* man_tbb = dynamic_cast<MandelbrotTBB*>(&mandelbrot)) {
+		if (threads) man_tbb->setMaxConcurrency(threads);
+		man_tbb->setGrainSize(grain);
+		man_tbb->setPartitioner(partitioner);
+	}
+}
+
+ViewSpec ViewSpec::capture(const Mandelbrot& mandelbrot)
+{
+	ViewSpec spec;
+
+	spec.x                = mandelbrot.getPositionX();
+	spec.y                = mandelbrot.getPositionY();
+	spec.scale            = mandelbrot.getScale();
+	spec.iter             = mandelbrot.getIteration();
+	spec.colormap         = mandelbrot.getColormap();
+	spec.color_scale      = mandelbrot.getColorScale();
+	spec.smooth           = mandelbrot.getColorSmooth();
+	spec.precision        = mandelbrot.getPrecision();
+	spec.samples          = mandelbrot.getTotalSample();
+	spec.samples_per_pass = mandelbrot.getSamplePerLaunch();
+	spec.sequence         = mandelbrot.getSampleSequence();
+	spec.seed             = mandelbrot.getSampleSeed();
+	spec.adaptive         = mandelbrot.getAdaptiveSampling();
+	spec.tolerance        = mandelbrot.getSampleTolerance();
+	spec.budget           = mandelbrot.getSampleBudget();
+	spec.width            = mandelbrot.getWidth();
+	spec.height           = mandelbrot.getHeight();
+
+	// the thread count stays with the machine, a captured view leaves it at every core
+	if (auto* man_tbb = dynamic_cast<const MandelbrotTBB*>(&mandelbrot)) {
+		spec.grain       = man_tbb->getGrainSize();
+		spec.partitioner = man_tbb->getPartitioner();
+	}
+
+	return spec;
+}
+
+unique_ptr<Mandelbrot> ViewSpec::createHeadless() const
+{
+	unique_ptr<Mandelbrot> mandelbrot;
+
+	if (backend == Backend::CPU)
+		mandelbrot = make_unique<Mandelbrot>(width, height);
+	else if (backend == Backend::CPU_TBB)
+		mandelbrot = make_unique<MandelbrotTBB>(width, height);
+	else
+		mandelbrot = make_unique<MandelbrotBignum>(width, height);
+
+	apply(*mandelbrot);
+	return mandelbrot;
+}
+
+unique_ptr<Mandelbrot> ViewSpec::create(SDL_Renderer* renderer) const
+{
+	unique_ptr<Mandelbrot> mandelbrot;
+
+	if (backend == Backend::CPU)
+		mandelbrot = make_unique<Mandelbrot>(renderer);
+	else if (backend == Backend::CPU_TBB)
+		mandelbrot = make_unique<MandelbrotTBB>(renderer);
+	else
+		mandelbrot = make_unique<MandelbrotBignum>(renderer);
+
+	apply(*mandelbrot);
+	return mandelbrot;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "mandelbrot_tbb.h"
+
+// everything needed to reproduce a render: where to look, how to color and sample it, and at which
+// size on which backend. read from "--key value" arguments or from a file of "key = value" lines,
+// save() writes the same format back. the GUI and the headless renderer both go through it.
+struct ViewSpec
+{
+	enum class Backend {
+		CPU        = 0,
+		CPU_TBB    = 1,
+		CPU_BIGNUM = 2
+	};
+
+	dd_real  x           = 0.;
+	dd_real  y           = 0.;
+	double   scale       = 1.;
+	uint32_t iter        = 100;
+	uint32_t colormap    = 1;
+	double   color_scale = 4.;
+	bool     smooth      = true;
+
+	Mandelbrot::Precision precision = Mandelbrot::Precision::Auto;
+
+	uint32_t           samples          = 1;
+	uint32_t           samples_per_pass = 1;
+	sampling::Sequence sequence         = sampling::Sequence::Sobol;
+	uint32_t           seed             = 0;
+	bool               adaptive         = false;
+	double             tolerance        = 1.;
+	uint32_t           budget           = 1 << 17;
+
+	int         width   = 1280;
+	int         height  = 720;
+	Backend     backend = Backend::CPU_TBB;
+	uint32_t    threads = 0; // 0 for every core
+	uint32_t    grain   = 1;
+	MandelbrotTBB::Partitioner partitioner = MandelbrotTBB::Partitioner::Auto;
+	std::string output;
+
+	static const char* usage;
+	static const char* getName(Mandelbrot::Precision precision);
+
+	bool set(const std::string& key, const std::string& value, std::string& error);
+	bool parseArgs(int argc, char* argv[], std::string& error);
+	bool load(const std::string& path, std::string& error);
+	bool save(const std::string& path) const;
+
+	void apply(Mandelbrot& mandelbrot) const;
+	static ViewSpec capture(const Mandelbrot& mandelbrot);
+
+	// a renderer of the chosen backend and size that is not tied to any window
+	std::unique_ptr<Mandelbrot> createHeadless() const;
+	// the same drawing into renderer, at the size of its window
+	std::unique_ptr<Mandelbrot> create(SDL_Renderer* renderer) const;
+};
\ No newline at end of file